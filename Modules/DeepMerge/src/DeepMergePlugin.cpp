@@ -31,11 +31,16 @@ related links:
 *******************************************************************************************************/
 
 #include "DeepMergePlugin.h"
+#include "NpyTensor.h"
 
 // ReadFramework
 #include "Settings.h"
 #include "Utils.h"
 #include "DeepMerge.h"
+#include "Drawer.h"
+#include "PageParser.h"
+#include "Elements.h"
+#include "ElementsHelper.h"
 #include "DkBasicLoader.h"
 
 // nomacs
@@ -46,10 +51,19 @@ related links:
 #include <QAction>
 #include <QUuid>
 #include <opencv2/ml.hpp>
+#include <opencv2/imgproc.hpp>
 
 #include <QLabel>
 #include <QDialogButtonBox>
 #include <QVBoxLayout>
+#include <QtConcurrentMap>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+#include <QMap>
+#include <QHash>
+
+#include <algorithm>
 
 #pragma warning(pop)		// no warnings from includes - end
 
@@ -60,6 +74,10 @@ namespace rdm {
 **/
 DeepMergePlugin::DeepMergePlugin(QObject* parent) : QObject(parent) {
 
+	// one thread writes all XMLs - so we do not block the batch
+	mXmlWriter = new QThreadPool(this);
+	mXmlWriter->setMaxThreadCount(1);
+
 	// create run IDs
 	QVector<QString> runIds;
 	runIds.resize(id_end);
@@ -100,11 +118,86 @@ DeepMergePlugin::DeepMergePlugin(QObject* parent) : QObject(parent) {
 *	Destructor
 **/
 DeepMergePlugin::~DeepMergePlugin() {
+
+	mXmlWriter->waitForDone();
 }
 
 void DeepMergePlugin::postLoadPlugin(const QVector<QSharedPointer<nmc::DkBatchInfo> >& batchInfo) const {
 
-	// add batch actions here...
+	// wait for the XMLs
+	mXmlWriter->waitForDone();
+
+	int numPages = 0;
+	int numRegions = 0;
+	qint64 time = 0;
+
+	for (auto bi : batchInfo) {
+
+		auto di = qSharedPointerDynamicCast<DeepMergeInfo>(bi);
+
+		if (!di)
+			continue;
+
+		numPages++;
+		numRegions += di->numRegions();
+		time += di->time();
+	}
+
+	if (numPages > 0) {
+		qInfo() << "DeepMerge:" << numRegions << "regions found in" << numPages << "pages";
+		qInfo() << "DeepMerge:" << time / numPages << "ms per page (" << time << "ms total)";
+	}
+}
+
+/// <summary>
+/// Adds the regions as TextRegions to the PAGE XML.
+/// Regions of previous runs (ids starting with DeepMerge_) are replaced.
+/// The XML is written in the background (one writer for all pages).
+/// </summary>
+/// <param name="loadXmlPath">The existing XML (if any).</param>
+/// <param name="saveXmlPath">The XML path where the results are written to.</param>
+/// <param name="regions">The region polygons (in page coordinates).</param>
+/// <param name="imgSize">The image size.</param>
+/// <param name="imgName">The image file name.</param>
+void DeepMergePlugin::saveXml(const QString& loadXmlPath, const QString& saveXmlPath, const QVector<QPolygonF>& regions, const QSize& imgSize, const QString& imgName) const {
+
+	QtConcurrent::run(mXmlWriter, [loadXmlPath, saveXmlPath, regions, imgSize, imgName]() {
+
+		// load suplemental XML
+		rdf::PageXmlParser parser;
+		parser.read(loadXmlPath);
+
+		// set our header info
+		auto xmlPage = parser.page();
+		xmlPage->setCreator(QString("CVL"));
+		xmlPage->setImageSize(imgSize);
+		xmlPage->setImageFileName(imgName);
+
+		const rdf::RegionManager& rm = rdf::RegionManager::instance();
+		auto root = xmlPage->rootRegion();
+
+		// remove the regions of previous runs - otherwise they are duplicated
+		const QString idPrefix = "DeepMerge_";
+		QVector<QSharedPointer<rdf::Region> > children;
+
+		for (auto c : root->children()) {
+			if (!c->id().startsWith(idPrefix))
+				children << c;
+		}
+
+		if (children.size() != root->children().size())
+			root->setChildren(children);
+
+		for (int idx = 0; idx < regions.size(); idx++) {
+
+			auto r = rm.createRegion(rdf::Region::type_text_region);
+			r->setId(idPrefix + QString::number(idx + 1));
+			r->setPolygon(rdf::Polygon(regions[idx]));
+			root->addChild(r);
+		}
+
+		parser.write(saveXmlPath, xmlPage);
+	});
 }
 
 QString DeepMergePlugin::settingsFilePath() const {
@@ -170,53 +263,48 @@ QSharedPointer<nmc::DkImageContainer> DeepMergePlugin::runPlugin(
 	const nmc::DkSaveInfo& saveInfo,
 	QSharedPointer<nmc::DkBatchInfo>& batchInfo) const {
 
-	//// load suplemental XML
-	//QString loadXmlPath = rdf::PageXmlParser::imagePathToXmlPath(saveInfo.inputFilePath());
-	//rdf::PageXmlParser parser;
-	//parser.read(loadXmlPath);
-
-	//// set our header info
-	//auto xmlPage = parser.page();
-	//xmlPage->setCreator(QString("CVL"));
-	//xmlPage->setImageSize(QSize(imgC->image().size()));
-	//xmlPage->setImageFileName(imgC->fileName());
-
-	// load side-car if available
-
 	if (!imgC)
 		return imgC;
 
-	// load side car image, if it is available
-	QString sideCarPath = imgC->dirPath() + "/dm/" + rdf::Utils::createFilePath(imgC->fileName(), "-probs", "png");
-	
-	QImage oImg = imgC->image();
-	QImage pImg = oImg;
-	nmc::DkBasicLoader bl;
-	if (bl.loadGeneral(sideCarPath)) {
-		pImg = bl.image();
-		imgC->setImage(pImg, "dhSegment");
-	}
-	else
-		qDebug() << "could not load" << sideCarPath;
+	QElapsedTimer dt;
+	dt.start();
+	QSharedPointer<DeepMergeInfo> dmInfo(new DeepMergeInfo(runID, imgC->filePath()));
 
-	cv::Mat imgCv = nmc::DkImage::qImage2Mat(pImg);
+	QImage oImg = imgC->image();
 	cv::Mat rImg;
+	cv::Mat imgCv;
+
+	// the overlay does not need the dhSegment side car
+	if (runID != mRunIDs[id_combine_result])
+		imgCv = loadProbabilities(imgC);
+	QVector<QPolygonF> regions;
 
 	if(runID == mRunIDs[id_graph_cut]) {
 
-		rImg = nmc::DkImage::qImage2Mat(oImg);
-		cv::Mat mask = compute(imgCv, rImg);
+		// we merge at the probability map's resolution
+		double sf = imgCv.rows > 0 ? (double)oImg.height() / imgCv.rows : 1.0;
+
+		// full resolution rasters are only needed for drawing
+		if (mConfig.drawResults())
+			rImg = nmc::DkImage::qImage2Mat(oImg);
+
+		cv::Mat mask = compute(imgCv, rImg, sf);
+		regions = regionPolygons(mask, sf);
+		qInfo() << regions.size() << "regions merged";
 
 		if (mask.channels() == 1)
 			cv::cvtColor(mask, mask, cv::COLOR_GRAY2RGB);
 
+		// NOTE: the mask has the probability map's resolution (not the image's)
+		// the full resolution visualization is added if drawResults is set
 		imgC->setImage(nmc::DkImage::mat2QImage(mask), "mask");
 
-		if (rImg.channels() == 1)
-			cv::cvtColor(rImg, rImg, cv::COLOR_GRAY2RGB);
-		QImage img = nmc::DkImage::mat2QImage(rImg);
-		imgC->setImage(img, tr("DeepMerge Visualized"));
-
+		if (!rImg.empty()) {
+			if (rImg.channels() == 1)
+				cv::cvtColor(rImg, rImg, cv::COLOR_GRAY2RGB);
+			QImage img = nmc::DkImage::mat2QImage(rImg);
+			imgC->setImage(img, tr("DeepMerge Visualized"));
+		}
 	}
 	else if (runID == mRunIDs[id_threshold]) {
 
@@ -224,6 +312,9 @@ QSharedPointer<nmc::DkImageContainer> DeepMergePlugin::runPlugin(
 		rdf::DeepMerge dm(imgCv);
 		rImg = dm.thresh(imgCv, 100);
 
+		double sf = imgCv.rows > 0 ? (double)oImg.height() / imgCv.rows : 1.0;
+		regions = regionPolygons(rImg, sf);
+
 		if (rImg.channels() == 1)
 			cv::cvtColor(rImg, rImg, cv::COLOR_GRAY2RGB);
 		QImage img = nmc::DkImage::mat2QImage(rImg);
@@ -241,53 +332,105 @@ QSharedPointer<nmc::DkImageContainer> DeepMergePlugin::runPlugin(
 		}
 
 
-		QImage img = imgC->image();
-		QImage pImg = bl.image();
+		cv::Mat img = nmc::DkImage::qImage2Mat(imgC->image());
+		cv::Mat probs = nmc::DkImage::qImage2Mat(bl.image());
 
-		//// we copy the background (red) channel to the alpha channel for a nicer visualization
-		//// extract & invert the red channel
-		//cv::Mat m = nmc::DkImage::qImage2Mat(pImg);
-		//std::vector<cv::Mat> ch;
-		//cv::split(m, ch);
-		//QImage ac = nmc::DkImage::mat2QImage(255 - ch[2]).copy();
+		rdf::Timer odt;
+		img = overlay(img, probs, 0.5);
+		qDebug() << "overlay computed in" << odt;
 
-		//// set the red channel to 0
-		//ch[2] = 0;
-		//cv::merge(ch, m);
+		imgC->setImage(nmc::DkImage::mat2QImage(img), tr("Probabilites"));
+	}
 
-		//pImg = nmc::DkImage::mat2QImage(m);
-		//pImg.setAlphaChannel(ac);
 
-		QPainter p(&img);
-		p.setOpacity(0.5);
-		p.drawImage(img.rect(), pImg, pImg.rect());
 
-		imgC->setImage(img, tr("Probabilites"));
-	}
+	bool merged = runID == mRunIDs[id_graph_cut] || runID == mRunIDs[id_threshold];
 
+	// save xml
+	if (merged && mConfig.saveXml()) {
 
+		QString loadXmlPath = rdf::PageXmlParser::imagePathToXmlPath(saveInfo.inputFilePath());
+		QString saveXmlPath = rdf::PageXmlParser::imagePathToXmlPath(saveInfo.outputFilePath());
 
-	//// save xml
-	//if (mConfig.saveXml()) {
-	//	QString saveXmlPath = rdf::PageXmlParser::imagePathToXmlPath(saveInfo.outputFilePath());
-	//	
-	//	if (saveXmlPath.isEmpty()) {
-	//		saveXmlPath = rdf::Utils::createFilePath(rdf::PageXmlParser::imagePathToXmlPath(imgC->filePath()), "-results");
-	//	}
-	//	
-	//	parser.write(saveXmlPath, parser.page());
-	//}
+		if (saveXmlPath.isEmpty()) {
+			saveXmlPath = rdf::Utils::createFilePath(rdf::PageXmlParser::imagePathToXmlPath(imgC->filePath()), "-results");
+		}
+
+		saveXml(loadXmlPath, saveXmlPath, regions, oImg.size(), imgC->fileName());
+	}
+
+	if (merged) {
+		dmInfo->setNumRegions(regions.size());
+		dmInfo->setTime(dt.elapsed());
+		batchInfo = dmInfo;
+	}
 
 	// wrong runID? - do nothing
 	return imgC;
 }
 
-cv::Mat DeepMergePlugin::compute(const cv::Mat & src, cv::Mat& visImg) const {
+/// <summary>
+/// Loads the dhSegment probabilities of the image.
+/// Raw tensors (dm/*-probs.npy) are memory mapped and preferred,
+/// if there are none, the png sidecar (dm/*-probs.png) is decoded.
+/// </summary>
+/// <param name="imgC">The image container.</param>
+/// <returns>The probability map (8 bit).</returns>
+cv::Mat DeepMergePlugin::loadProbabilities(QSharedPointer<nmc::DkImageContainer> imgC) const {
+
+	QString npyPath = imgC->dirPath() + "/dm/" + rdf::Utils::createFilePath(imgC->fileName(), "-probs", "npy");
+
+	if (QFileInfo(npyPath).exists()) {
+
+		rdf::Timer dt;
+		NpyTensor t(npyPath);
+
+		if (t.load()) {
+
+			cv::Mat probs = t.toMat8U();
+			qDebug() << "tensor loaded in" << dt;
+
+			// we only need the QImage for visualization
+			if (mConfig.drawResults())
+				imgC->setImage(nmc::DkImage::mat2QImage(probs), "dhSegment");
+
+			return probs;
+		}
+		else
+			qWarning() << "could not load" << npyPath << "-" << t.errorString();
+	}
+
+	// load side car image, if it is available
+	QString sideCarPath = imgC->dirPath() + "/dm/" + rdf::Utils::createFilePath(imgC->fileName(), "-probs", "png");
+
+	QImage pImg = imgC->image();
+	nmc::DkBasicLoader bl;
+	if (bl.loadGeneral(sideCarPath)) {
+		pImg = bl.image();
+		imgC->setImage(pImg, "dhSegment");
+	}
+	else
+		qDebug() << "could not load" << sideCarPath;
+
+	return nmc::DkImage::qImage2Mat(pImg);
+}
+
+/// <summary>
+/// Merges the probability map.
+/// </summary>
+/// <param name="src">The probability map.</param>
+/// <param name="visImg">The visualization image (nothing is drawn if it is empty).</param>
+/// <param name="sf">The scale factor from the probability map to the image.</param>
+/// <returns>The merged mask (with the probability map's resolution).</returns>
+cv::Mat DeepMergePlugin::compute(const cv::Mat & src, cv::Mat& visImg, double sf) const {
+
+	int ts = mConfig.tileSize();
+	if (ts > 0 && (src.cols > ts || src.rows > ts))
+		return computeTiled(src, visImg, sf);
 
 	rdf::Timer dt;
 
 	cv::Mat img = src.clone();
-	double sf = (double)visImg.rows / src.rows;
 
 	// compute layout analysis
 	rdf::DeepMerge dm(img);
@@ -298,9 +441,496 @@ cv::Mat DeepMergePlugin::compute(const cv::Mat & src, cv::Mat& visImg) const {
 	if (!dm.compute())
 		qWarning() << "could not compute DeepMerge...";
 
-	visImg = dm.draw(visImg);
+	if (!visImg.empty())
+		visImg = dm.draw(visImg);
+
+	// the scale factor is only needed for drawing - DeepMerge might return
+	// its mask at image resolution, but regionPolygons scales it (once) to the page
+	cv::Mat mask = dm.image();
+
+	if (!mask.empty() && mask.size() != src.size())
+		cv::resize(mask, mask, src.size(), 0, 0, cv::INTER_NEAREST);
+
+	return mask;
+}
+
+/// <summary>
+/// Returns one label per pixel (CV_32S).
+/// Color masks are labeled per color (colors are packed so that labels
+/// are not merged), gray masks per value (any depth).
+/// </summary>
+/// <param name="mask">The mask (0 is background).</param>
+cv::Mat DeepMergePlugin::labelImage(const cv::Mat & mask) {
+
+	cv::Mat labels;
+
+	if (mask.channels() == 1) {
+		mask.convertTo(labels, CV_32S);
+		return labels;
+	}
+
+	cv::Mat m8 = mask;
+	if (m8.depth() != CV_8U)
+		m8.convertTo(m8, CV_8U);
+
+	labels = cv::Mat(m8.size(), CV_32SC1);
+	int cn = qMin(m8.channels(), 3);
+
+	for (int rIdx = 0; rIdx < m8.rows; rIdx++) {
+
+		const uchar* ptr = m8.ptr<uchar>(rIdx);
+		int* lPtr = labels.ptr<int>(rIdx);
+
+		for (int cIdx = 0; cIdx < m8.cols; cIdx++, ptr += m8.channels()) {
+
+			int l = 0;
+			for (int c = 0; c < cn; c++)
+				l |= ptr[c] << (8 * c);
+			lPtr[cIdx] = l;
+		}
+	}
+
+	return labels;
+}
+
+/// <summary>
+/// Returns the outer contours of all labels in mask (scaled to page coordinates).
+/// Color masks are labeled per color, gray masks per value (any depth).
+/// </summary>
+/// <param name="mask">The mask (0 is background).</param>
+/// <param name="sf">The scale factor from the mask to the image.</param>
+QVector<QPolygonF> DeepMergePlugin::regionPolygons(const cv::Mat & mask, double sf) const {
+
+	QVector<QPolygonF> regions;
+
+	if (mask.empty())
+		return regions;
+
+	cv::Mat labels = labelImage(mask);
+
+	// find all labels and their bounding boxes
+	QMap<int, cv::Rect> boxes;
+	for (int rIdx = 0; rIdx < labels.rows; rIdx++) {
+
+		const int* ptr = labels.ptr<int>(rIdx);
+
+		for (int cIdx = 0; cIdx < labels.cols; cIdx++) {
+
+			if (ptr[cIdx] == 0)
+				continue;
+
+			cv::Rect& r = boxes[ptr[cIdx]];
+
+			if (r.area() == 0)
+				r = cv::Rect(cIdx, rIdx, 1, 1);
+			else
+				r |= cv::Rect(cIdx, rIdx, 1, 1);
+		}
+	}
+
+	for (auto it = boxes.constBegin(); it != boxes.constEnd(); it++) {
+
+		// only compare within the label's box
+		cv::Rect box = it.value();
+		cv::Mat lMask;
+		cv::compare(labels(box), cv::Scalar(it.key()), lMask, cv::CMP_EQ);
+
+		std::vector<std::vector<cv::Point> > contours;
+		cv::findContours(lMask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, box.tl());
+
+		for (const std::vector<cv::Point>& c : contours) {
+
+			if (c.size() < 3)
+				continue;
+
+			QPolygonF poly;
+			poly.reserve((int)c.size());
+			for (const cv::Point& p : c)
+				poly << QPointF(p.x * sf, p.y * sf);
+
+			regions << poly;
+		}
+	}
+
+	return regions;
+}
+
+/// <summary>
+/// Splits the probability map into overlapping tiles which are merged concurrently.
+/// Each tile only contributes its core (the tile without overlap) to the
+/// result, so seams are computed with context from the neighboring tiles.
+/// Tiles label their regions independently. Hence, labels of neighboring
+/// tiles are joined (union-find) if they cover each other in the overlap
+/// band, so that regions are neither cut nor merged at the seams.
+/// </summary>
+/// <param name="src">The probability map.</param>
+/// <param name="visImg">The visualization image (nothing is drawn if it is empty).</param>
+/// <param name="sf">The scale factor from the probability map to the image.</param>
+/// <returns>The merged mask (one unique color per region).</returns>
+cv::Mat DeepMergePlugin::computeTiled(const cv::Mat & src, cv::Mat & visImg, double sf) const {
+
+	struct Tile {
+		cv::Rect rect;		// tile incl. overlap
+		cv::Rect core;		// the part we keep
+		cv::Mat labels;		// CV_32S labels 1..numLabels (0 is background)
+		cv::Mat vis;
+		int numLabels = 0;
+		int offset = 0;		// first global label - 1
+		double energy = 0;
+		qint64 time = 0;		// ms
+		bool ok = false;
+	};
+
+	rdf::Timer dt;
+
+	int ts = mConfig.tileSize();
+	int ov = mConfig.tileOverlap();
+	bool draw = !visImg.empty();
+
+	cv::Rect srcRect(0, 0, src.cols, src.rows);
+	cv::Rect visRect(0, 0, visImg.cols, visImg.rows);
+
+	auto scaled = [&](const cv::Rect& r) {
+		cv::Point tl(qRound(r.x * sf), qRound(r.y * sf));
+		cv::Point br(qRound(r.br().x * sf), qRound(r.br().y * sf));
+		return cv::Rect(tl, br) & visRect;
+	};
+
+	QVector<Tile> tiles;
+	for (int y = 0; y < src.rows; y += ts) {
+		for (int x = 0; x < src.cols; x += ts) {
+
+			Tile t;
+			t.core = cv::Rect(x, y, ts, ts) & srcRect;
+			t.rect = cv::Rect(x - ov, y - ov, ts + 2 * ov, ts + 2 * ov) & srcRect;
+			tiles << t;
+		}
+	}
+
+	QtConcurrent::blockingMap(tiles, [&](Tile& t) {
+
+		QElapsedTimer tdt;
+		tdt.start();
+
+		rdf::DeepMerge dm(src(t.rect).clone());
+		dm.setScaleFactor(sf);
+
+		t.ok = dm.compute() && !dm.image().empty();
+
+		// failed tiles are background
+		if (!t.ok) {
+			qWarning() << "could not compute DeepMerge for tile" << t.rect.x << t.rect.y;
+			t.labels = cv::Mat::zeros(t.rect.size(), CV_32SC1);
+			t.time = tdt.elapsed();
+			return;
+		}
+
+		cv::Mat mask = dm.image();
+
+		if (mask.size() != t.rect.size())
+			cv::resize(mask, mask, t.rect.size(), 0, 0, cv::INTER_NEAREST);
+
+		// compact the tile's labels to 1..numLabels
+		t.labels = labelImage(mask);
+		QHash<int, int> compact;
+
+		for (int rIdx = 0; rIdx < t.labels.rows; rIdx++) {
+
+			int* ptr = t.labels.ptr<int>(rIdx);
+
+			for (int cIdx = 0; cIdx < t.labels.cols; cIdx++) {
+
+				if (ptr[cIdx] == 0)
+					continue;
+
+				auto it = compact.find(ptr[cIdx]);
+				if (it == compact.end())
+					it = compact.insert(ptr[cIdx], compact.size() + 1);
+				ptr[cIdx] = it.value();
+			}
+		}
+
+		t.numLabels = compact.size();
+		t.energy = energy(src(t.rect), t.labels);
+
+		if (draw) {
+			cv::Mat vis = visImg(scaled(t.rect)).clone();
+			t.vis = dm.draw(vis);
+		}
+
+		t.time = tdt.elapsed();
+	});
+
+	// global labels
+	int numLabels = 0;
+	for (Tile& t : tiles) {
+		t.offset = numLabels;
+		numLabels += t.numLabels;
+	}
+
+	QVector<int> parent(numLabels + 1);
+	for (int idx = 0; idx < parent.size(); idx++)
+		parent[idx] = idx;
+
+	auto find = [&](int l) {
+
+		while (parent[l] != l) {
+			parent[l] = parent[parent[l]];
+			l = parent[l];
+		}
+		return l;
+	};
+
+	// join the labels of neighboring tiles that cover each other in the overlap band
+	// we only join the best match of each label so that noise does not chain regions
+	for (int i = 0; i < tiles.size(); i++) {
+		for (int j = i + 1; j < tiles.size(); j++) {
+
+			const Tile& ti = tiles[i];
+			const Tile& tj = tiles[j];
+			cv::Rect band = ti.rect & tj.rect;
+
+			if (band.area() == 0 || ti.numLabels == 0 || tj.numLabels == 0)
+				continue;
+
+			cv::Mat li = ti.labels(band - ti.rect.tl());
+			cv::Mat lj = tj.labels(band - tj.rect.tl());
+
+			QHash<QPair<int, int>, int> counts;
+
+			for (int rIdx = 0; rIdx < band.height; rIdx++) {
+
+				const int* pi = li.ptr<int>(rIdx);
+				const int* pj = lj.ptr<int>(rIdx);
+
+				for (int cIdx = 0; cIdx < band.width; cIdx++) {
+
+					if (pi[cIdx] > 0 && pj[cIdx] > 0)
+						counts[qMakePair(pi[cIdx], pj[cIdx])]++;
+				}
+			}
+
+			QHash<int, QPair<int, int> > bestI, bestJ;	// label -> (match, count)
+
+			for (auto it = counts.constBegin(); it != counts.constEnd(); it++) {
+
+				int a = it.key().first;
+				int b = it.key().second;
+
+				if (it.value() > bestI.value(a, qMakePair(0, 0)).second)
+					bestI[a] = qMakePair(b, it.value());
+				if (it.value() > bestJ.value(b, qMakePair(0, 0)).second)
+					bestJ[b] = qMakePair(a, it.value());
+			}
+
+			for (auto it = bestI.constBegin(); it != bestI.constEnd(); it++)
+				parent[find(ti.offset + it.key())] = find(tj.offset + it.value().first);
+
+			for (auto it = bestJ.constBegin(); it != bestJ.constEnd(); it++)
+				parent[find(tj.offset + it.key())] = find(ti.offset + it.value().first);
+		}
+	}
+
+	// stitch the cores
+	cv::Mat labels(src.size(), CV_32SC1, cv::Scalar(0));
+	double energySum = 0;
+
+	for (const Tile& t : tiles) {
+
+		cv::Mat core = t.labels(t.core - t.rect.tl());
+		cv::Mat dst = labels(t.core);
+
+		for (int rIdx = 0; rIdx < core.rows; rIdx++) {
+
+			const int* sPtr = core.ptr<int>(rIdx);
+			int* dPtr = dst.ptr<int>(rIdx);
+
+			for (int cIdx = 0; cIdx < core.cols; cIdx++)
+				dPtr[cIdx] = sPtr[cIdx] > 0 ? find(t.offset + sPtr[cIdx]) : 0;
+		}
+
+		if (draw && !t.vis.empty()) {
+
+			cv::Rect sr = scaled(t.rect);
+			cv::Rect sc = scaled(t.core) & sr;
+			cv::Rect vr = (sc - sr.tl()) & cv::Rect(0, 0, t.vis.cols, t.vis.rows);
 
-	return dm.image();
+			if (vr.size() == sc.size())
+				t.vis(vr).copyTo(visImg(sc));
+		}
+
+		energySum += t.energy;
+		qDebug() << "tile" << t.rect.x << t.rect.y << t.rect.width << "x" << t.rect.height 
+			<< "merged in" << t.time << "ms, energy:" << t.energy;
+	}
+
+	// one unique color per region: the (odd) multiplier is a bijection on 24 bit
+	// which spreads neighboring labels over the color space
+	QHash<int, int> colors;
+	cv::Mat mask(src.size(), CV_8UC3);
+
+	for (int rIdx = 0; rIdx < labels.rows; rIdx++) {
+
+		const int* lPtr = labels.ptr<int>(rIdx);
+		uchar* mPtr = mask.ptr<uchar>(rIdx);
+
+		for (int cIdx = 0; cIdx < labels.cols; cIdx++, mPtr += 3) {
+
+			int c = 0;
+
+			if (lPtr[cIdx] > 0) {
+
+				auto it = colors.find(lPtr[cIdx]);
+				if (it == colors.end())
+					it = colors.insert(lPtr[cIdx], ((colors.size() + 1) * 0x9E3779) & 0xFFFFFF);
+				c = it.value();
+			}
+
+			mPtr[0] = (uchar)(c & 0xFF);
+			mPtr[1] = (uchar)((c >> 8) & 0xFF);
+			mPtr[2] = (uchar)((c >> 16) & 0xFF);
+		}
+	}
+
+	qInfo() << tiles.size() << "tiles merged in" << dt << "-" << colors.size() << "regions, energy:" << energySum;
+
+	return mask;
+}
+
+/// <summary>
+/// Returns the Potts energy of a labeling.
+/// The data term is the probability of the opposite class (1 - p(fg) for
+/// regions, p(fg) for background) and each label change between
+/// 4-connected pixels costs 1. rdf::DeepMerge does not expose its solver's
+/// energy, so this is evaluated on the result to compare tiles.
+/// </summary>
+/// <param name="probs">The probability map (BGR: background is red, or gray: foreground).</param>
+/// <param name="labels">The labels (CV_32S, 0 is background).</param>
+double DeepMergePlugin::energy(const cv::Mat & probs, const cv::Mat & labels) {
+
+	double e = 0;
+	int cn = probs.channels();
+	int bgChannel = cn >= 3 ? 2 : 0;
+
+	for (int rIdx = 0; rIdx < labels.rows; rIdx++) {
+
+		const uchar* pPtr = probs.ptr<uchar>(rIdx);
+		const int* lPtr = labels.ptr<int>(rIdx);
+		const int* nPtr = rIdx + 1 < labels.rows ? labels.ptr<int>(rIdx + 1) : 0;
+
+		int data = 0;
+		int smooth = 0;
+
+		for (int cIdx = 0; cIdx < labels.cols; cIdx++, pPtr += cn) {
+
+			int fg = cn >= 3 ? 255 - pPtr[bgChannel] : pPtr[0];
+			data += lPtr[cIdx] > 0 ? 255 - fg : fg;
+
+			if (cIdx + 1 < labels.cols && lPtr[cIdx] != lPtr[cIdx + 1])
+				smooth++;
+			if (nPtr && lPtr[cIdx] != nPtr[cIdx])
+				smooth++;
+		}
+
+		e += data / 255.0 + smooth;
+	}
+
+	return e;
+}
+
+/// <summary>
+/// Blends the class probabilities onto the image.
+/// Each class (channel) is mapped to a color and weighted by its probability,
+/// the background (red channel) keeps the image as is. The kernel runs in
+/// parallel over rows and uses fixed-point arithmetic so that the inner loop
+/// can be vectorized by the compiler.
+/// </summary>
+/// <param name="img">The image.</param>
+/// <param name="probs">The probabilities (BGR, background is red).</param>
+/// <param name="opacity">The overlay's opacity [0 1].</param>
+/// <returns>The composited image (BGRA).</returns>
+cv::Mat DeepMergePlugin::overlay(const cv::Mat & img, const cv::Mat & probs, double opacity) const {
+
+	cv::Mat dst;
+	if (img.channels() == 4)
+		dst = img.clone();
+	else if (img.channels() == 3)
+		cv::cvtColor(img, dst, cv::COLOR_BGR2BGRA);
+	else
+		cv::cvtColor(img, dst, cv::COLOR_GRAY2BGRA);
+
+	cv::Mat p = probs;
+	if (p.channels() == 1)
+		cv::cvtColor(p, p, cv::COLOR_GRAY2BGR);
+	else if (p.channels() == 4)
+		cv::cvtColor(p, p, cv::COLOR_BGRA2BGR);
+
+	if (p.size() != dst.size())
+		cv::resize(p, p, dst.size(), 0, 0, cv::INTER_LINEAR);
+
+	// class colors (channel 2 is the background)
+	const int bgChannel = 2;
+	int cb[3], cg[3], cr[3], cw[3];
+
+	for (int cIdx = 0; cIdx < 3; cIdx++) {
+		QColor c = rdf::ColorManager::getColor(cIdx);
+		cb[cIdx] = cIdx == bgChannel ? 0 : c.blue();
+		cg[cIdx] = cIdx == bgChannel ? 0 : c.green();
+		cr[cIdx] = cIdx == bgChannel ? 0 : c.red();
+		cw[cIdx] = cIdx == bgChannel ? 0 : 1;
+	}
+
+	const int alpha = qRound(qBound(0.0, opacity, 1.0) * 256);
+
+	cv::parallel_for_(cv::Range(0, dst.rows), [&](const cv::Range& range) {
+
+		for (int rIdx = range.start; rIdx < range.end; rIdx++) {
+
+			uchar* d = dst.ptr<uchar>(rIdx);
+			const uchar* s = p.ptr<uchar>(rIdx);
+
+			for (int cIdx = 0; cIdx < dst.cols; cIdx++, d += 4, s += 3) {
+
+				int p0 = s[0], p1 = s[1], p2 = s[2];
+
+				// probability weighted class color (premultiplied with the foreground probability)
+				int mb = std::min(255, (p0 * cb[0] + p1 * cb[1] + p2 * cb[2]) >> 8);
+				int mg = std::min(255, (p0 * cg[0] + p1 * cg[1] + p2 * cg[2]) >> 8);
+				int mr = std::min(255, (p0 * cr[0] + p1 * cr[1] + p2 * cr[2]) >> 8);
+
+				// foreground probability scales the opacity
+				int w = std::min(255, p0 * cw[0] + p1 * cw[1] + p2 * cw[2]);
+				int a = (alpha * w) >> 8;
+
+				// the color is premultiplied - so it is only weighted by the opacity
+				d[0] = (uchar)((d[0] * (256 - a) + mb * alpha) >> 8);
+				d[1] = (uchar)((d[1] * (256 - a) + mg * alpha) >> 8);
+				d[2] = (uchar)((d[2] * (256 - a) + mr * alpha) >> 8);
+			}
+		}
+	});
+
+	return dst;
+}
+
+// DeepMergeInfo --------------------------------------------------------------------
+DeepMergeInfo::DeepMergeInfo(const QString & id, const QString & filePath) : nmc::DkBatchInfo(id, filePath) {
+}
+
+void DeepMergeInfo::setNumRegions(int numRegions) {
+	mNumRegions = numRegions;
+}
+
+int DeepMergeInfo::numRegions() const {
+	return mNumRegions;
+}
+
+void DeepMergeInfo::setTime(qint64 ms) {
+	mTime = ms;
+}
+
+qint64 DeepMergeInfo::time() const {
+	return mTime;
 }
 
 // configurations that are specific for the plugin --------------------------------------------------------------------
@@ -312,6 +942,9 @@ QString DeepMergeConfig::toString() const {
 	QString msg = rdf::ModuleConfig::toString();
 	msg += drawResults() ? " drawing results\n" : " not drawing results\n";
 
+	if (tileSize() > 0)
+		msg += " tile size: " + QString::number(tileSize()) + " overlap: " + QString::number(tileOverlap()) + "\n";
+
 	return msg;
 }
 
@@ -327,11 +960,21 @@ bool DeepMergeConfig::saveXml() const {
 	return mSaveXml;
 }
 
+int DeepMergeConfig::tileSize() const {
+	return mTileSize;
+}
+
+int DeepMergeConfig::tileOverlap() const {
+	return mTileOverlap;
+}
+
 void DeepMergeConfig::load(const QSettings & settings) {
 
 	mDrawResults = settings.value("drawResults", mDrawResults).toBool();
 	mSaveXml = settings.value("saveXml", mSaveXml).toBool();
 	mResultPath = settings.value("tfResultPath", mResultPath).toString();
+	mTileSize = settings.value("tileSize", mTileSize).toInt();
+	mTileOverlap = settings.value("tileOverlap", mTileOverlap).toInt();
 }
 
 void DeepMergeConfig::save(QSettings & settings) const {
@@ -339,6 +982,8 @@ void DeepMergeConfig::save(QSettings & settings) const {
 	settings.setValue("drawResults", mDrawResults);
 	settings.setValue("saveXml", mSaveXml);
 	settings.setValue("tfResultPath", mResultPath);
+	settings.setValue("tileSize", mTileSize);
+	settings.setValue("tileOverlap", mTileOverlap);
 }
 
 };
@@ -37,8 +37,12 @@ related links:
 
 #pragma warning(push, 0)	// no warnings from includes - begin
 #include <QDialog>
+#include <QPolygonF>
 #pragma warning(pop)		// no warnings from includes - end
 
+// Qt defines
+class QThreadPool;
+
 // opencv defines
 namespace cv {
 	class Mat;
@@ -58,17 +62,37 @@ public:
 
 	bool drawResults() const;
 	bool saveXml() const;
+	int tileSize() const;
+	int tileOverlap() const;
 
 protected:
 	
 	bool mDrawResults = false;
 	bool mSaveXml = true;
 	QString mResultPath;
+	int mTileSize = 0;			// probability map tile size (0 = no tiling)
+	int mTileOverlap = 64;		// overlap between tiles
 
 	void load(const QSettings& settings) override;
 	void save(QSettings& settings) const override;
 };
 
+class DeepMergeInfo : public nmc::DkBatchInfo {
+
+public:
+	DeepMergeInfo(const QString& id = QString(), const QString& filePath = QString());
+
+	void setNumRegions(int numRegions);
+	int numRegions() const;
+
+	void setTime(qint64 ms);
+	qint64 time() const;
+
+private:
+	int mNumRegions = 0;
+	qint64 mTime = 0;		// processing time in ms
+};
+
 class DeepMergePlugin : public QObject, nmc::DkBatchPluginInterface {
 	Q_OBJECT
 		Q_INTERFACES(nmc::DkBatchPluginInterface)
@@ -111,8 +135,16 @@ protected:
 	QStringList mMenuNames;
 	QStringList mMenuStatusTips;
 	DeepMergeConfig mConfig;
+	QThreadPool* mXmlWriter = 0;
 
 	// layout plugin functions
-	cv::Mat compute(const cv::Mat& src, cv::Mat& visImg) const;
+	cv::Mat loadProbabilities(QSharedPointer<nmc::DkImageContainer> imgC) const;
+	cv::Mat compute(const cv::Mat& src, cv::Mat& visImg, double sf) const;
+	cv::Mat computeTiled(const cv::Mat& src, cv::Mat& visImg, double sf) const;
+	QVector<QPolygonF> regionPolygons(const cv::Mat& mask, double sf) const;
+	static cv::Mat labelImage(const cv::Mat& mask);
+	static double energy(const cv::Mat& probs, const cv::Mat& labels);
+	cv::Mat overlay(const cv::Mat& img, const cv::Mat& probs, double opacity) const;
+	void saveXml(const QString& loadXmlPath, const QString& saveXmlPath, const QVector<QPolygonF>& regions, const QSize& imgSize, const QString& imgName) const;
 };
 };
@@ -0,0 +1,216 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#include "NpyTensor.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QDebug>
+#include <QRegularExpression>
+#include <QStringList>
+
+#include <cstring>
+
+#include <opencv2/imgproc.hpp>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+// NpyTensor --------------------------------------------------------------------
+NpyTensor::NpyTensor(const QString& filePath) {
+	mFilePath = filePath;
+}
+
+/// <summary>
+/// Maps the file and parses the npy header.
+/// No data is copied or decoded here.
+/// </summary>
+/// <returns>true if the tensor could be mapped.</returns>
+bool NpyTensor::load() {
+
+	mFile = QSharedPointer<QFile>(new QFile(mFilePath));
+
+	if (!mFile->open(QIODevice::ReadOnly)) {
+		mError = "could not open " + mFilePath;
+		return false;
+	}
+
+	qint64 size = mFile->size();
+	const uchar* data = mFile->map(0, size);
+
+	if (!data || size < 10 || memcmp(data, "\x93NUMPY", 6) != 0) {
+		mError = mFilePath + " is not a npy file";
+		return false;
+	}
+
+	// v1.0 has a 2 byte header length, v2.0 & v3.0 4 bytes
+	int major = data[6];
+	qint64 headerLen = 0;
+	qint64 dataOffset = 0;
+
+	if (major == 1) {
+		headerLen = data[8] | (data[9] << 8);
+		dataOffset = 10 + headerLen;
+	}
+	else if (size >= 12) {
+		headerLen = data[8] | (data[9] << 8) | (data[10] << 16) | ((qint64)data[11] << 24);
+		dataOffset = 12 + headerLen;
+	}
+
+	if (dataOffset <= 0 || dataOffset > size) {
+		mError = "corrupted npy header in " + mFilePath;
+		return false;
+	}
+
+	int depth = -1;
+	std::vector<int> shape;
+	QByteArray header((const char*)data + dataOffset - headerLen, (int)headerLen);
+
+	if (!parseHeader(header, depth, shape))
+		return false;
+
+	int channels = shape.size() == 3 ? shape[2] : 1;
+	int type = CV_MAKETYPE(depth, channels);
+
+	if ((qint64)shape[0] * shape[1] * CV_ELEM_SIZE(type) > size - dataOffset) {
+		mError = "npy data is truncated: " + mFilePath;
+		return false;
+	}
+
+	mData = cv::Mat(shape[0], shape[1], type, (void*)(data + dataOffset));
+
+	return true;
+}
+
+bool NpyTensor::isEmpty() const {
+	return mData.empty();
+}
+
+QString NpyTensor::errorString() const {
+	return mError;
+}
+
+/// <summary>
+/// Returns the raw tensor (a view on the mapped file).
+/// NOTE: float16 data is returned as CV_16S.
+/// </summary>
+cv::Mat NpyTensor::data() const {
+	return mData;
+}
+
+/// <summary>
+/// Returns the tensor as 8 bit BGR(A) image.
+/// uint8 data is not converted (but copied), float probabilities [0 1] are scaled to [0 255].
+/// </summary>
+cv::Mat NpyTensor::toMat8U() const {
+
+	if (mData.empty())
+		return cv::Mat();
+
+	cv::Mat img;
+
+	if (mHalf) {
+		cv::Mat f;
+		cv::convertFp16(mData, f);
+		f.convertTo(img, CV_8U, 255.0);
+	}
+	else if (mFloat)
+		mData.convertTo(img, CV_8U, 255.0);
+	else
+		img = mData.clone();
+
+	// numpy tensors are RGB
+	if (img.channels() == 3)
+		cv::cvtColor(img, img, cv::COLOR_RGB2BGR);
+
+	return img;
+}
+
+bool NpyTensor::parseHeader(const QByteArray & header, int & cvDepth, std::vector<int>& shape) {
+
+	QString h = QString::fromLatin1(header);
+
+	QRegularExpression descrExp("'descr'\\s*:\\s*'([<>|=])([uif])(\\d)'");
+	QRegularExpression orderExp("'fortran_order'\\s*:\\s*(True|False)");
+	QRegularExpression shapeExp("'shape'\\s*:\\s*\\(([^)]*)\\)");
+
+	QRegularExpressionMatch dm = descrExp.match(h);
+	QRegularExpressionMatch om = orderExp.match(h);
+	QRegularExpressionMatch sm = shapeExp.match(h);
+
+	if (!dm.hasMatch() || !om.hasMatch() || !sm.hasMatch()) {
+		mError = "could not parse npy header: " + h;
+		return false;
+	}
+
+	if (om.captured(1) == "True") {
+		mError = "fortran ordered npy files are not supported";
+		return false;
+	}
+
+	if (dm.captured(1) == ">") {
+		mError = "big endian npy files are not supported";
+		return false;
+	}
+
+	QString kind = dm.captured(2);
+	int bytes = dm.captured(3).toInt();
+
+	if (kind == "u" && bytes == 1)
+		cvDepth = CV_8U;
+	else if (kind == "f" && bytes == 2) {
+		cvDepth = CV_16S;	// we convert with cv::convertFp16
+		mHalf = true;
+	}
+	else if (kind == "f" && bytes == 4) {
+		cvDepth = CV_32F;
+		mFloat = true;
+	}
+	else {
+		mError = "unsupported npy type: " + dm.captured(0);
+		return false;
+	}
+
+	for (const QString& s : sm.captured(1).split(",", QString::SkipEmptyParts)) {
+		if (!s.trimmed().isEmpty())
+			shape.push_back(s.trimmed().toInt());
+	}
+
+	if (shape.size() < 2 || shape.size() > 3 || shape[0] <= 0 || shape[1] <= 0 || 
+		(shape.size() == 3 && (shape[2] <= 0 || shape[2] > CV_CN_MAX))) {
+		mError = "unsupported npy shape: " + sm.captured(0);
+		return false;
+	}
+
+	return true;
+}
+
+}
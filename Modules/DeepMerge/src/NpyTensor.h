@@ -0,0 +1,72 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QString>
+#include <QFile>
+#include <QSharedPointer>
+#include <opencv2/core.hpp>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+/// <summary>
+/// Memory mapped numpy (.npy) tensor.
+/// Supported are C-ordered uint8, float16 and float32 arrays
+/// with a shape of (rows, cols) or (rows, cols, channels).
+/// </summary>
+class NpyTensor {
+
+public:
+	NpyTensor(const QString& filePath = QString());
+
+	bool load();
+	bool isEmpty() const;
+	QString errorString() const;
+
+	cv::Mat data() const;
+	cv::Mat toMat8U() const;
+
+private:
+	QString mFilePath;
+	QString mError;
+	QSharedPointer<QFile> mFile;	// keeps the mapping alive
+	cv::Mat mData;					// view on the mapped memory
+	bool mHalf = false;				// float16 data (stored as CV_16S)
+	bool mFloat = false;
+
+	bool parseHeader(const QByteArray& header, int& cvDepth, std::vector<int>& shape);
+};
+
+};
@@ -0,0 +1,163 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#include "AllocationCounter.h"
+
+namespace rdm {
+
+// AllocationCounter --------------------------------------------------------------------
+AllocationCounter::AllocationCounter() : mBytes(0), mPeakBytes(0), mNumAllocations(0) {
+	mStdAllocator = cv::Mat::getStdAllocator();
+}
+
+AllocationCounter& AllocationCounter::instance() {
+
+	// NOTE: the counter is never destroyed since
+	// mats that were allocated by it might still be alive
+	static AllocationCounter* inst = new AllocationCounter();
+	return *inst;
+}
+
+/// <summary>
+/// Starts a counting session.
+/// The first session resets the peak and installs the counter as default allocator.
+/// </summary>
+void AllocationCounter::start() {
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if (mSessions == 0) {
+		mPeakBytes = mBytes.load();
+		mNumAllocations = 0;
+		mMaxSessions = 0;
+		cv::Mat::setDefaultAllocator(this);
+	}
+
+	mSessions++;
+	mMaxSessions = qMax(mMaxSessions, mSessions);
+}
+
+/// <summary>
+/// Ends a counting session.
+/// The last session restores OpenCV's standard allocator.
+/// Mats allocated in the meantime are still released by the counter.
+/// </summary>
+void AllocationCounter::stop() {
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if (mSessions == 0)
+		return;
+
+	mSessions--;
+
+	if (mSessions == 0)
+		cv::Mat::setDefaultAllocator(mStdAllocator);
+}
+
+int64 AllocationCounter::bytes() const {
+	return mBytes;
+}
+
+int64 AllocationCounter::peakBytes() const {
+	return mPeakBytes;
+}
+
+int AllocationCounter::numAllocations() const {
+	return mNumAllocations;
+}
+
+/// <summary>
+/// Returns the max number of concurrent sessions since the counter was reset.
+/// If this is > 1, the numbers are shared by several images.
+/// </summary>
+int AllocationCounter::concurrentSessions() const {
+	return mMaxSessions;
+}
+
+QString AllocationCounter::toString() const {
+
+	QString msg;
+	msg += QString::number(numAllocations()) + " allocations, ";
+	msg += "peak: " + QString::number(peakBytes() / (1024.0*1024.0), 'f', 1) + " MB, ";
+	msg += "current: " + QString::number(bytes() / (1024.0*1024.0), 'f', 1) + " MB";
+
+	if (concurrentSessions() > 1)
+		msg += " (shared by " + QString::number(concurrentSessions()) + " concurrent images)";
+
+	return msg;
+}
+
+cv::UMatData* AllocationCounter::allocate(int dims, const int* sizes, int type, void* data, size_t* step, int flags, cv::UMatUsageFlags usageFlags) const {
+
+	cv::UMatData* u = mStdAllocator->allocate(dims, sizes, type, data, step, flags, usageFlags);
+
+	if (!u)
+		return u;
+
+	u->currAllocator = this;	// make sure we get the deallocate call
+
+	if (!data) {
+		int64 cb = (mBytes += (int64)u->size);
+		mNumAllocations++;
+
+		// update the peak
+		int64 pb = mPeakBytes;
+		while (cb > pb && !mPeakBytes.compare_exchange_weak(pb, cb))
+			;
+	}
+
+	return u;
+}
+
+bool AllocationCounter::allocate(cv::UMatData* data, int accessflags, cv::UMatUsageFlags usageFlags) const {
+	return mStdAllocator->allocate(data, accessflags, usageFlags);
+}
+
+void AllocationCounter::deallocate(cv::UMatData* data) const {
+
+	if (!data)
+		return;
+
+	if (!(data->flags & cv::UMatData::USER_ALLOCATED))
+		mBytes -= (int64)data->size;
+
+	mStdAllocator->deallocate(data);
+}
+
+QDebug operator<<(QDebug d, const AllocationCounter& ac) {
+
+	d << qPrintable(ac.toString());
+	return d;
+}
+
+}
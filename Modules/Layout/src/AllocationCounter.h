@@ -0,0 +1,91 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QString>
+#include <QDebug>
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <mutex>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+/// <summary>
+/// Counts the memory allocated by cv::Mat.
+/// If started, the counter is installed as OpenCV's default allocator
+/// and forwards all requests to the standard allocator. It tracks the
+/// current and the peak number of bytes. OpenCV's default allocator is
+/// process-wide: the counter is installed by the first start() and removed
+/// by the last stop(). If images are processed concurrently, the numbers
+/// cover all of them (see concurrentSessions()).
+/// </summary>
+class AllocationCounter : public cv::MatAllocator {
+
+public:
+	static AllocationCounter& instance();
+
+	void start();
+	void stop();
+
+	int64 bytes() const;
+	int64 peakBytes() const;
+	int numAllocations() const;
+	int concurrentSessions() const;
+
+	QString toString() const;
+
+	// cv::MatAllocator
+	cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, int flags, cv::UMatUsageFlags usageFlags) const override;
+	bool allocate(cv::UMatData* data, int accessflags, cv::UMatUsageFlags usageFlags) const override;
+	void deallocate(cv::UMatData* data) const override;
+
+private:
+	AllocationCounter();
+	AllocationCounter(const AllocationCounter&);
+
+	cv::MatAllocator* mStdAllocator = 0;
+
+	std::mutex mMutex;
+	int mSessions = 0;				// number of running start/stop sessions
+	int mMaxSessions = 0;			// max. concurrent sessions since the counter was reset
+
+	mutable std::atomic<int64> mBytes;
+	mutable std::atomic<int64> mPeakBytes;
+	mutable std::atomic<int> mNumAllocations;
+};
+
+QDebug operator<<(QDebug d, const AllocationCounter& ac);
+
+};
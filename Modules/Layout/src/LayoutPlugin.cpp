@@ -31,6 +31,7 @@ related links:
 *******************************************************************************************************/
 
 #include "LayoutPlugin.h"
+#include "AllocationCounter.h"
 
 // ReadFramework
 #include "SuperPixel.h"
@@ -66,6 +67,8 @@ related links:
 #include <QLabel>
 #include <QDialogButtonBox>
 #include <QVBoxLayout>
+#include <QtConcurrentMap>
+#include <opencv2/imgproc.hpp>
 
 #pragma warning(pop)		// no warnings from includes - end
 
@@ -290,6 +293,9 @@ QSharedPointer<nmc::DkImageContainer> LayoutPlugin::runPlugin(
 	if (!imgC)
 		return imgC;
 
+	if (mConfig.countAllocations())
+		AllocationCounter::instance().start();
+
 	// load suplemental XML
 	QString loadXmlPath = rdf::PageXmlParser::imagePathToXmlPath(saveInfo.inputFilePath());
 	rdf::PageXmlParser parser;
@@ -302,6 +308,7 @@ QSharedPointer<nmc::DkImageContainer> LayoutPlugin::runPlugin(
 	xmlPage->setImageFileName(imgC->fileName());
 
 
+	// NOTE: qImage2Mat copies the pixels - the layout functions draw their results into imgCv
 	if(runID == mRunIDs[id_layout]) {
 
 		cv::Mat imgCv = nmc::DkImage::qImage2Mat(imgC->image());
@@ -395,20 +402,39 @@ QSharedPointer<nmc::DkImageContainer> LayoutPlugin::runPlugin(
 		parser.write(saveXmlPath, parser.page());
 	}
 
+	if (mConfig.countAllocations()) {
+		AllocationCounter::instance().stop();
+		qInfo() << "cv::Mat allocations:" << AllocationCounter::instance();
+	}
+
 	// wrong runID? - do nothing
 	return imgC;
 }
 
-cv::Mat LayoutPlugin::compute(const cv::Mat & src, rdf::PageXmlParser & parser) const {
+/// <summary>
+/// Computes the layout analysis and adds its results to the parser's page.
+/// NOTE: results are drawn into src (if drawResults is set) - so pass an image you own.
+/// </summary>
+cv::Mat LayoutPlugin::compute(cv::Mat & src, rdf::PageXmlParser & parser) const {
 
 
 	rdf::Timer dt;
 
-	cv::Mat img = src.clone();
 	auto pe = parser.page();
 
+	// restrict the analysis to the text regions of the XML (if there are any)
+	if (mConfig.useTextRegions()) {
+
+		QVector<QSharedPointer<rdf::Region> > regions = rdf::Region::filter(pe->rootRegion().data(), rdf::Region::type_text_region);
+
+		if (!regions.empty())
+			return computeTextRegions(src, pe, regions);
+
+		qInfo() << "no text regions found - computing the full page";
+	}
+
 	// compute layout analysis
-	rdf::LayoutAnalysis la(img);
+	rdf::LayoutAnalysis la(src);
 	la.setConfig(QSharedPointer<rdf::LayoutAnalysisConfig>(new rdf::LayoutAnalysisConfig(mLAConfig)));
 
 
@@ -421,7 +447,7 @@ cv::Mat LayoutPlugin::compute(const cv::Mat & src, rdf::PageXmlParser & parser)
 	
 	// write to XML --------------------------------------------------------------------
 	pe->setCreator(QString("CVL"));
-	pe->setImageSize(QSize(img.cols, img.rows));
+	pe->setImageSize(QSize(src.cols, src.rows));
 
 	auto root = la.textBlockSet().toTextRegion();
 	for (const QSharedPointer<rdf::Region>& r : root->children()) {
@@ -443,18 +469,98 @@ cv::Mat LayoutPlugin::compute(const cv::Mat & src, rdf::PageXmlParser & parser)
 	// draw results -----------------------------------
 	if (mConfig.drawResults()) {
 
-		cv::Mat rImg = img.clone();
-
 		// draw whatever you like
-		rImg = la.draw(rImg/*, rdf::ColorManager::green()*/);
+		return la.draw(src/*, rdf::ColorManager::green()*/);
+	}
 
-		return rImg;
+	return src;
+}
+
+cv::Mat LayoutPlugin::computeTextRegions(cv::Mat & src, QSharedPointer<rdf::PageElement>& page, const QVector<QSharedPointer<rdf::Region> >& regions) const {
+
+	rdf::Timer dt;
+
+	QRect imgRect(0, 0, src.cols, src.rows);
+	int pad = qMax(mConfig.textRegionPadding(), 0);
+
+	QVector<TextRegionLayout> layouts;
+
+	for (auto r : regions) {
+
+		QRect roi = r->polygon().polygon().boundingRect().toAlignedRect();
+
+		// skip degenerated regions
+		if (roi.isEmpty()) {
+			qDebug() << "skipping empty text region" << r->id();
+			continue;
+		}
+
+		QRect regionRect = roi.intersected(imgRect);
+		roi = roi.adjusted(-pad, -pad, pad, pad).intersected(imgRect);
+
+		layouts << TextRegionLayout(r, roi, regionRect);
+	}
+
+	// the crops are independent - so analyze them concurrently
+	// NOTE: every crop gets its own rdf::LayoutAnalysis and config copies. This is
+	// what the batch processing does anyway - it runs the analysis of several pages concurrently
+	QtConcurrent::blockingMap(layouts, [&](TextRegionLayout& l) {
+
+		if (!l.compute(src, mLAConfig, mSfConfig))
+			qWarning() << "could not compute layout analysis for" << l.region()->id();
+	});
+
+	// write to XML --------------------------------------------------------------------
+	page->setCreator(QString("CVL"));
+	page->setImageSize(QSize(src.cols, src.rows));
+
+	for (int idx = 0; idx < layouts.size(); idx++) {
+
+		const TextRegionLayout& l = layouts[idx];
+
+		// keep the old lines if nothing was computed
+		if (!l.isComputed())
+			continue;
+
+		// the text lines are re-computed - all other children are kept
+		QVector<QSharedPointer<rdf::Region> > children;
+		for (auto c : l.region()->children()) {
+			if (c->type() != rdf::Region::type_text_line)
+				children << c;
+		}
+
+		l.region()->setChildren(children + l.textLines());
+
+		for (const rdf::Line& s : l.stopLines()) {
+
+			// stop lines of overlapping regions are written once
+			QPointF c = s.qLine().center();
+			bool written = false;
+			for (int pIdx = 0; pIdx < idx && !written; pIdx++)
+				written = layouts[pIdx].isComputed() && layouts[pIdx].regionRect().contains(c.toPoint());
+
+			if (written)
+				continue;
+
+			QSharedPointer<rdf::SeparatorRegion> sp(new rdf::SeparatorRegion(s));
+			page->rootRegion()->addUniqueChild(sp, true);
+		}
+	}
+
+	qInfo() << "layout analysis of" << layouts.size() << "text regions computed in" << dt;
+
+	// draw results -----------------------------------
+	if (mConfig.drawResults()) {
+
+		// all crops are computed - so we can draw into src
+		for (const TextRegionLayout& l : layouts)
+			l.draw(src);
 	}
 
 	return src;
 }
 
-cv::Mat LayoutPlugin::computePageSegmentation(const cv::Mat & src, const rdf::PageXmlParser & parser) const {
+cv::Mat LayoutPlugin::computePageSegmentation(cv::Mat & src, const rdf::PageXmlParser & parser) const {
 	
 	// if available, get informaton from existing xmls
 	auto pe = parser.page();
@@ -469,7 +575,7 @@ cv::Mat LayoutPlugin::computePageSegmentation(const cv::Mat & src, const rdf::Pa
 
 	qInfo() << "I found" << separatingLines.size() << "separators in the XML";
 
-	cv::Mat img = src.clone();
+	cv::Mat& img = src;
 	//cv::resize(src, img, cv::Size(), 0.25, 0.25, CV_INTER_AREA);
 
 	rdf::Timer dt;
@@ -516,7 +622,7 @@ cv::Mat LayoutPlugin::computePageSegmentation(const cv::Mat & src, const rdf::Pa
 
 	// draw results -----------------------------------
 	//cv::Mat rImg(img.rows, img.cols, CV_8UC1, cv::Scalar::all(150));
-	cv::Mat rImg = img.clone();
+	cv::Mat rImg = img;	// the results are drawn into src
 
 	//// draw edges
 	//rImg = textBlocks.draw(rImg);
@@ -533,7 +639,7 @@ cv::Mat LayoutPlugin::computePageSegmentation(const cv::Mat & src, const rdf::Pa
 	return rImg;
 }
 
-cv::Mat LayoutPlugin::collectFeatures(const cv::Mat & src, const rdf::PageXmlParser & parser, QSharedPointer<FeatureCollectionInfo>& layoutInfo) const {
+cv::Mat LayoutPlugin::collectFeatures(cv::Mat & src, const rdf::PageXmlParser & parser, QSharedPointer<FeatureCollectionInfo>& layoutInfo) const {
 
 	rdf::Timer dt;
 
@@ -567,8 +673,7 @@ cv::Mat LayoutPlugin::collectFeatures(const cv::Mat & src, const rdf::PageXmlPar
 	layoutInfo->setFeatureCollectionManager(fcm);
 
 	if (mConfig.drawResults()) {
-		cv::Mat rImg = src.clone();
-		rImg = spl.draw(rImg);
+		cv::Mat rImg = spl.draw(src);
 		//rImg = spf.draw(rImg);
 		return rImg;
 	}
@@ -576,7 +681,7 @@ cv::Mat LayoutPlugin::collectFeatures(const cv::Mat & src, const rdf::PageXmlPar
 	return src;
 }
 
-cv::Mat LayoutPlugin::classifyRegions(const cv::Mat & src, const rdf::PageXmlParser & parser, QSharedPointer<StatsInfo>& statsInfo) const {
+cv::Mat LayoutPlugin::classifyRegions(cv::Mat & src, const rdf::PageXmlParser & parser, QSharedPointer<StatsInfo>& statsInfo) const {
 
 	rdf::Timer dt;
 	
@@ -750,6 +855,168 @@ bool LayoutPlugin::train() const {
 	return false;
 }
 
+// TextRegionLayout --------------------------------------------------------------------
+TextRegionLayout::TextRegionLayout(const QSharedPointer<rdf::Region>& region, const QRect& roi, const QRect& regionRect) {
+	mRegion = region;
+	mRoi = roi;
+	mRegionRect = regionRect;
+}
+
+bool TextRegionLayout::compute(const cv::Mat & img, const rdf::LayoutAnalysisConfig & laConfig, const rdf::ScaleFactoryConfig & sfConfig) {
+
+	if (!mRegion || mRoi.isEmpty())
+		return false;
+
+	// NOTE: the crop is a view - we do not copy any pixels here
+	cv::Mat crop = img(cvRoi());
+
+	QPointF offset = mRoi.topLeft();
+
+	// the analysis sees the region (in crop coordinates) as its root - like the full page analysis
+	QPolygonF poly = mRegion->polygon().polygon();
+	poly.translate(-offset);
+
+	QSharedPointer<rdf::TextRegion> tr(new rdf::TextRegion());
+	tr->setId(mRegion->id());
+	tr->setPolygon(rdf::Polygon(poly));
+
+	QSharedPointer<rdf::RootRegion> root(new rdf::RootRegion());
+	root->addUniqueChild(tr);
+
+	rdf::LayoutAnalysis la(crop);
+	la.setConfig(QSharedPointer<rdf::LayoutAnalysisConfig>(new rdf::LayoutAnalysisConfig(laConfig)));
+	la.scaleFactory()->setConfig(QSharedPointer<rdf::ScaleFactoryConfig>(new rdf::ScaleFactoryConfig(cropConfig(sfConfig, QSize(img.cols, img.rows), QSize(crop.cols, crop.rows)))));
+	la.setRootRegion(root);
+
+	if (!la.compute())
+		return false;
+
+	// map results back to page coordinates (only the lines are kept)
+	auto tbRoot = la.textBlockSet().toTextRegion();
+	mTextLines = rdf::Region::filter(tbRoot.data(), rdf::Region::type_text_line);
+
+	for (auto tl : mTextLines)
+		translate(tl, offset);
+
+	// the padding contains parts of neighbouring regions - keep the stop lines of this region only
+	for (const rdf::Line& s : la.stopLines()) {
+
+		QLineF l = s.qLine().translated(offset);
+
+		if (mRegionRect.contains(l.center().toPoint()))
+			mStopLines << rdf::Line(l, s.thickness());
+	}
+
+	mComputed = true;
+
+	return true;
+}
+
+/// <summary>
+/// Returns a scale config that results in the page's scale factor for the crop.
+/// The ScaleFactory derives its scale factor from the image size,
+/// without this, small regions would be upscaled.
+/// </summary>
+/// <param name="config">The page's scale config.</param>
+/// <param name="pageSize">The page size.</param>
+/// <param name="cropSize">The crop size.</param>
+/// <returns>The crop's scale config.</returns>
+rdf::ScaleFactoryConfig TextRegionLayout::cropConfig(const rdf::ScaleFactoryConfig & config, const QSize & pageSize, const QSize & cropSize) {
+
+	rdf::ScaleFactoryConfig cc = config;
+
+	// dpi based scaling does not depend on the image size
+	if (config.scaleMode() == rdf::ScaleFactoryConfig::scale_dpi)
+		return cc;
+
+	double ratio = 1.0;
+
+	if (config.scaleMode() == rdf::ScaleFactoryConfig::scale_height)
+		ratio = (double)cropSize.height() / qMax(pageSize.height(), 1);
+	else
+		ratio = (double)qMax(cropSize.width(), cropSize.height()) / qMax(qMax(pageSize.width(), pageSize.height()), 1);
+
+	cc.setMaxImageSide(qMax(qRound(config.maxImageSide() * ratio), 1));
+
+	return cc;
+}
+
+/// <summary>
+/// Draws the region's bounding box (without padding), its text lines and stop lines.
+/// </summary>
+void TextRegionLayout::draw(cv::Mat & img) const {
+
+	cv::Rect rr(mRegionRect.x(), mRegionRect.y(), mRegionRect.width(), mRegionRect.height());
+	cv::rectangle(img, rr, cv::Scalar(0, 200, 0), 2);
+
+	for (auto r : mTextLines) {
+
+		auto tl = qSharedPointerDynamicCast<rdf::TextLine>(r);
+		if (!tl)
+			continue;
+
+		QPolygon bl = tl->baseLine().toPolygon();
+		std::vector<cv::Point> pts;
+		for (const QPoint& p : bl)
+			pts.push_back(cv::Point(p.x(), p.y()));
+
+		if (pts.size() > 1)
+			cv::polylines(img, pts, false, cv::Scalar(200, 0, 200), 2);
+	}
+
+	for (const rdf::Line& s : mStopLines) {
+		QLineF l = s.qLine();
+		cv::line(img, cv::Point2d(l.x1(), l.y1()), cv::Point2d(l.x2(), l.y2()), cv::Scalar(0, 0, 200), 2);
+	}
+}
+
+QSharedPointer<rdf::Region> TextRegionLayout::region() const {
+	return mRegion;
+}
+
+QRect TextRegionLayout::roi() const {
+	return mRoi;
+}
+
+QRect TextRegionLayout::regionRect() const {
+	return mRegionRect;
+}
+
+QVector<QSharedPointer<rdf::Region> > TextRegionLayout::textLines() const {
+	return mTextLines;
+}
+
+QVector<rdf::Line> TextRegionLayout::stopLines() const {
+	return mStopLines;
+}
+
+bool TextRegionLayout::isComputed() const {
+	return mComputed;
+}
+
+void TextRegionLayout::translate(QSharedPointer<rdf::Region> region, const QPointF & offset) {
+
+	if (!region)
+		return;
+
+	QPolygonF poly = region->polygon().polygon();
+	poly.translate(offset);
+	region->setPolygon(rdf::Polygon(poly));
+
+	if (auto tl = qSharedPointerDynamicCast<rdf::TextLine>(region)) {
+		QPolygonF bl = tl->baseLine().polygon().polygon();
+		bl.translate(offset);
+		tl->setBaseLine(rdf::BaseLine(rdf::Polygon(bl)));
+	}
+
+	for (auto c : region->children())
+		translate(c, offset);
+}
+
+cv::Rect TextRegionLayout::cvRoi() const {
+	return cv::Rect(mRoi.x(), mRoi.y(), mRoi.width(), mRoi.height());
+}
+
 // FeatureCollectionInfo --------------------------------------------------------------------
 FeatureCollectionInfo::FeatureCollectionInfo(const QString & id, const QString & filePath) : nmc::DkBatchInfo(id, filePath) {
 }
@@ -783,7 +1050,7 @@ QString LayoutConfig::toString() const {
 
 	QString msg = rdf::ModuleConfig::toString();
 	msg += drawResults() ? " drawing results\n" : " not drawing results\n";
-	msg += useTextRegions() ? " baselines are filtered with text regions\n" : " full image is computed\n";
+	msg += useTextRegions() ? " layout is computed on text region crops\n" : " full image is computed\n";
 
 	return msg;
 }
@@ -800,11 +1067,21 @@ bool LayoutConfig::useTextRegions() const {
 	return mUseTextRegions;
 }
 
+int LayoutConfig::textRegionPadding() const {
+	return mTextRegionPadding;
+}
+
+bool LayoutConfig::countAllocations() const {
+	return mCountAllocations;
+}
+
 void LayoutConfig::load(const QSettings & settings) {
 
 	mUseTextRegions = settings.value("useTextRegions", mUseTextRegions).toBool();
 	mDrawResults	= settings.value("drawResults", mDrawResults).toBool();
 	mSaveXml		= settings.value("saveXml", mSaveXml).toBool();
+	mTextRegionPadding = settings.value("textRegionPadding", mTextRegionPadding).toInt();
+	mCountAllocations = settings.value("countAllocations", mCountAllocations).toBool();
 }
 
 void LayoutConfig::save(QSettings & settings) const {
@@ -812,6 +1089,8 @@ void LayoutConfig::save(QSettings & settings) const {
 	settings.setValue("useTextRegions", mUseTextRegions);
 	settings.setValue("drawResults", mDrawResults);
 	settings.setValue("saveXml", mSaveXml);
+	settings.setValue("textRegionPadding", mTextRegionPadding);
+	settings.setValue("countAllocations", mCountAllocations);
 }
 
 // TODO: move to nomacs
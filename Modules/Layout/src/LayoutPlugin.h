@@ -53,6 +53,7 @@ namespace cv {
 namespace rdf {
 	class LineTrace;
 	class PageXmlParser;
+	class PageElement;
 }
 
 namespace rdm {
@@ -68,17 +69,55 @@ public:
 	bool drawResults() const;
 	bool saveXml() const;
 	bool useTextRegions() const;
+	int textRegionPadding() const;
+	bool countAllocations() const;
 
 protected:
 	
 	bool mDrawResults = false;
-	bool mUseTextRegions = false;
+	bool mUseTextRegions = false;	// if true, the layout is computed on (concurrent) text region crops
 	bool mSaveXml = true;
+	int mTextRegionPadding = 20;	// padding (in px) added to text region crops
+	bool mCountAllocations = false;	// if true, cv::Mat allocations are reported per image
 
 	void load(const QSettings& settings) override;
 	void save(QSettings& settings) const override;
 };
 
+/// <summary>
+/// Layout analysis restricted to the crop of a single text region.
+/// Only the resulting lines are kept, they are mapped back to page coordinates.
+/// </summary>
+class TextRegionLayout {
+
+public:
+	TextRegionLayout(const QSharedPointer<rdf::Region>& region = QSharedPointer<rdf::Region>(), const QRect& roi = QRect(), const QRect& regionRect = QRect());
+
+	bool compute(const cv::Mat& img, const rdf::LayoutAnalysisConfig& laConfig, const rdf::ScaleFactoryConfig& sfConfig);
+	void draw(cv::Mat& img) const;
+
+	QSharedPointer<rdf::Region> region() const;
+	QRect roi() const;
+	QRect regionRect() const;
+	QVector<QSharedPointer<rdf::Region> > textLines() const;
+	QVector<rdf::Line> stopLines() const;
+	bool isComputed() const;
+
+	static void translate(QSharedPointer<rdf::Region> region, const QPointF& offset);
+	static rdf::ScaleFactoryConfig cropConfig(const rdf::ScaleFactoryConfig& config, const QSize& pageSize, const QSize& cropSize);
+
+private:
+	QSharedPointer<rdf::Region> mRegion;
+	QRect mRoi;					// padded crop
+	QRect mRegionRect;			// bounding box of the region (without padding)
+
+	QVector<QSharedPointer<rdf::Region> > mTextLines;
+	QVector<rdf::Line> mStopLines;
+	bool mComputed = false;
+
+	cv::Rect cvRoi() const;
+};
+
 class FeatureCollectionInfo : public nmc::DkBatchInfo {
 
 public:
@@ -177,11 +216,12 @@ protected:
 	rdf::ScaleFactoryConfig mSfConfig;
 	LayoutConfig mConfig;
 
-	// layout plugin functions
-	cv::Mat compute(const cv::Mat& src, rdf::PageXmlParser& parser) const;
-	cv::Mat computePageSegmentation(const cv::Mat& src, const rdf::PageXmlParser& parser) const;
-	cv::Mat collectFeatures(const cv::Mat& src, const rdf::PageXmlParser& parser, QSharedPointer<FeatureCollectionInfo>& layoutInfo) const;
-	cv::Mat classifyRegions(const cv::Mat& src, const rdf::PageXmlParser& parser, QSharedPointer<StatsInfo>& statsInfo) const;
+	// layout plugin functions (results are drawn into src)
+	cv::Mat compute(cv::Mat& src, rdf::PageXmlParser& parser) const;
+	cv::Mat computeTextRegions(cv::Mat& src, QSharedPointer<rdf::PageElement>& page, const QVector<QSharedPointer<rdf::Region> >& regions) const;
+	cv::Mat computePageSegmentation(cv::Mat& src, const rdf::PageXmlParser& parser) const;
+	cv::Mat collectFeatures(cv::Mat& src, const rdf::PageXmlParser& parser, QSharedPointer<FeatureCollectionInfo>& layoutInfo) const;
+	cv::Mat classifyRegions(cv::Mat& src, const rdf::PageXmlParser& parser, QSharedPointer<StatsInfo>& statsInfo) const;
 	rdf::LineTrace computeLines(QSharedPointer<nmc::DkImageContainer> imgC) const;
 	bool train() const;
 };
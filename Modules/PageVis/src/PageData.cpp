@@ -35,6 +35,7 @@
 // framework
 #include "PageParser.h"
 #include "Settings.h"
+#include "Utils.h"
 
 // nomacs
 #include "DkSettings.h"
@@ -42,6 +43,16 @@
 #pragma warning(push, 0)	// no warnings from includes
 #include <QDebug>
 #include <QSettings>
+#include <QtMath>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
+
+#include <opencv2/imgproc.hpp>
+
+#include <cmath>
+#include <algorithm>
 #pragma warning(pop)
 
 namespace rdm {
@@ -57,6 +68,14 @@ PageData::PageData(QObject* parent) : QObject(parent) {
 PageData::~PageData() {
 
 	saveConfig("Recent Settings");
+
+	// do not lose any pages
+	for (QFuture<void>& f : mPendingSaves)
+		f.waitForFinished();
+
+	// the parsers must not outlive us
+	for (auto& f : mPendingLoads)
+		f.waitForFinished();
 }
 
 QVector<QSharedPointer<rdf::RegionTypeConfig> > PageData::config() const {
@@ -71,6 +90,139 @@ QString PageData::xmlPath() const {
 	return mXmlPath;
 }
 
+/// <summary>
+/// Returns the spatial index of the current page.
+/// The index is built on first use after the page changed.
+/// </summary>
+QSharedPointer<RegionIndex> PageData::regionIndex() const {
+
+	if (!mIndex) {
+		mIndex = QSharedPointer<RegionIndex>(new RegionIndex(mPage ? mPage->rootRegion() : QSharedPointer<rdf::RootRegion>()));
+		qDebug() << "region index with" << mIndex->size() << "regions built";
+	}
+
+	return mIndex;
+}
+
+void PageData::invalidateIndex() {
+	mIndex.clear();
+	mLod.clear();
+}
+
+/// <summary>
+/// Returns the zoom bucket (log2 of the scale).
+/// e.g. 0 for 100%, -1 for 50%, -2 for 25%
+/// </summary>
+int PageData::zoomBucket(double scale) {
+
+	if (scale <= 0)
+		return 0;
+
+	return qFloor(std::log2(scale));
+}
+
+/// <summary>
+/// Returns all regions simplified for the zoom bucket.
+/// Polygons & baselines are simplified (Douglas-Peucker) with a tolerance 
+/// of one screen pixel and regions smaller than a few screen pixels are 
+/// collapsed to their bounding box. The result is cached per bucket.
+/// </summary>
+/// <param name="zoomBucket">The zoom bucket.</param>
+QVector<LodRegion> PageData::lodRegions(int zoomBucket) const {
+
+	auto it = mLod.find(zoomBucket);
+	if (it != mLod.end())
+		return it.value();
+
+	rdf::Timer dt;
+
+	// tolerance of one screen pixel in image coordinates
+	double tol = 1.0 / qPow(2.0, zoomBucket);
+	double minSize = 4.0 * tol;
+
+	auto simplify = [&](const QPolygonF& poly, bool closed) {
+
+		if (poly.size() < 3)
+			return poly;
+
+		std::vector<cv::Point2f> pts;
+		pts.reserve(poly.size());
+		for (const QPointF& p : poly)
+			pts.push_back(cv::Point2f((float)p.x(), (float)p.y()));
+
+		std::vector<cv::Point2f> sPts;
+		cv::approxPolyDP(pts, sPts, tol, closed);
+
+		QPolygonF sPoly;
+		sPoly.reserve((int)sPts.size());
+		for (const cv::Point2f& p : sPts)
+			sPoly << QPointF(p.x, p.y);
+
+		return sPoly;
+	};
+
+	QVector<LodRegion> regions;
+
+	if (mPage) {
+
+		for (auto r : mPage->rootRegion()->allRegions()) {
+
+			LodRegion lr;
+			lr.region = r;
+			lr.polygon = r->polygon().polygon();
+			lr.box = lr.polygon.boundingRect();
+
+			auto tl = r.dynamicCast<rdf::TextLine>();
+			if (tl) {
+				QPolygonF bl = tl->baseLine().polygon().polygon();
+				lr.box = lr.box.united(bl.boundingRect());
+				lr.baseLine = simplify(bl, false);
+			}
+
+			lr.lineHeight = lineHeight(r);
+
+			if (lr.box.width() < minSize && lr.box.height() < minSize) {
+				lr.polygon = QPolygonF(lr.box);
+				lr.baseLine.clear();
+				lr.collapsed = true;
+			}
+			else
+				lr.polygon = simplify(lr.polygon, true);
+
+			regions << lr;
+		}
+	}
+
+	mLod.insert(zoomBucket, regions);
+	qDebug() << "LOD for zoom bucket" << zoomBucket << "computed in" << dt;
+
+	return regions;
+}
+
+/// <summary>
+/// Returns the (median) text line height of region.
+/// Regions without text lines return their own height.
+/// </summary>
+double PageData::lineHeight(QSharedPointer<rdf::Region> region) {
+
+	QVector<double> heights;
+
+	if (region->type() != rdf::Region::type_text_line) {
+
+		for (auto c : region->children()) {
+			if (c->type() == rdf::Region::type_text_line && !c->polygon().polygon().isEmpty())
+				heights << c->polygon().polygon().boundingRect().height();
+		}
+	}
+
+	if (heights.empty())
+		return region->polygon().polygon().boundingRect().height();
+
+	std::nth_element(heights.begin(), heights.begin() + heights.size() / 2, heights.end());
+
+	return heights[heights.size() / 2];
+}
+
 void PageData::loadConfig(const QString & name) {
 	
 	// gcc: you cannot write loadSettings(rdf::DefaultSettings(), name);
@@ -94,12 +246,19 @@ void PageData::deleteSelected() {
 	if (!mPage)
 		return;
 
+	waitForSaves();
+
 	auto r = mPage->rootRegion()->selectedRegions();
 
 	for (auto s : r) {
 		mPage->rootRegion()->removeChild(s);
 	}
 
+	if (!r.empty())
+		setDirty();
+
+	invalidateIndex();
+
 	emit updatePage(mPage);
 }
 
@@ -114,41 +273,273 @@ QSharedPointer<rdf::Region> PageData::addRegion(const QRectF & rect, const rdf::
 	auto r = rdf::RegionManager::instance().createRegion(type);
 	r->setPolygon(p);
 
+	waitForSaves();
+
 	mPage->rootRegion()->addUniqueChild(r);
+	invalidateIndex();
+	setDirty();
 
 	return r;
 }
 
+/// <summary>
+/// Shows the page of xmlPath.
+/// Recently used (or prefetched) pages are taken from the cache.
+/// Otherwise, the page is parsed in the background and updatePage
+/// is emitted as soon as it is available.
+/// A modified current page is saved before it is replaced.
+/// </summary>
+/// <param name="xmlPath">The XML path.</param>
 void PageData::parse(const QString& xmlPath) {
 
 	if (mPage && xmlPath == mPage->xmlPath())
 		return;
 
-	rdf::PageXmlParser parser;
-	parser.read(xmlPath);
+	// setPage resets the dirty flag - so write the edits before switching
+	// (the edited page stays cached and its timestamp is updated once the save is done)
+	if (mPage && mDirty)
+		save();
 
-	mPage = parser.page();
-	qDebug() << "filename: " << mPage->imageFileName();
+	mRequestedPath = xmlPath;
 
-	emit updatePage(mPage);
+	// never hand out a page that is currently written
+	waitForSave(xmlPath);
+
+	auto page = cachedPage(xmlPath);
+
+	if (page) {
+		setPage(page);
+		return;
+	}
+
+	// remove the old page while we are loading
+	setPage(QSharedPointer<rdf::PageElement>());
+	load(xmlPath);
 }
 
+/// <summary>
+/// Saves the current page in the background.
+/// If no xmlPath is specified, the page is only written if it was modified.
+/// NOTE: everything that edits regions must call regionChanged() (or setDirty())
+/// otherwise the edits are not saved.
+/// </summary>
+/// <param name="xmlPath">The XML path (if empty, the page's path is used).</param>
 void PageData::save(const QString& xmlPath) {
 
 	if (!mPage)
 		return;
 
+	// do not touch unchanged files
+	if (xmlPath.isEmpty() && !mDirty)
+		return;
+
 	QString xmlPathI = xmlPath;
 
 	if (xmlPathI.isEmpty())
 		xmlPathI = mPage->xmlPath();
 
+	cleanSaves();
+
+	// one writer per file
+	waitForSave(xmlPathI);
+
+	auto page = mPage;
+	mPendingSaves.insert(xmlPathI, QtConcurrent::run([page, xmlPathI]() {
+
+		if (!writePage(page, xmlPathI))
+			qWarning() << "could not save" << xmlPathI;
+	}));
+
+	if (xmlPathI == mPage->xmlPath())
+		mDirty = false;
+
+	emit updatePage(mPage);
+}
+
+void PageData::setDirty(bool dirty) {
+	mDirty = dirty;
+}
+
+/// <summary>
+/// Call this if a region of the current page was edited (e.g. polygon, baseline, text or type).
+/// The page is marked as modified and the spatial index is rebuilt on next use.
+/// </summary>
+void PageData::regionChanged() {
+
+	setDirty();
+	invalidateIndex();
+}
+
+bool PageData::isDirty() const {
+	return mDirty;
+}
+
+/// <summary>
+/// Writes the page atomically.
+/// The page is serialized into a QSaveFile which replaces xmlPath 
+/// in a single step - so readers never see a partially written XML.
+/// Nothing is replaced if serializing or writing fails.
+/// </summary>
+/// <returns>true on success.</returns>
+bool PageData::writePage(QSharedPointer<rdf::PageElement> page, const QString & xmlPath) {
+
 	rdf::PageXmlParser parser;
-	parser.write(xmlPathI, mPage);
+	QByteArray xml = parser.writePageElement(page);
+
+	if (xml.isEmpty())
+		return false;
+
+	QSaveFile f(xmlPath);
+
+	if (!f.open(QIODevice::WriteOnly))
+		return false;
+
+	if (f.write(xml) != xml.size()) {
+		f.cancelWriting();
+		return false;
+	}
+
+	return f.commit();
+}
+
+/// <summary>
+/// Parses the XMLs in the background so that they are cached once the user gets there.
+/// </summary>
+/// <param name="xmlPaths">The XML paths.</param>
+void PageData::prefetch(const QStringList & xmlPaths) {
+
+	for (const QString& p : xmlPaths) {
+
+		if (mCache.contains(p) || mPendingLoads.contains(p) || mPendingSaves.contains(p))
+			continue;
+
+		if (QFileInfo(p).exists())
+			load(p);
+	}
+}
+
+/// <summary>
+/// Blocks until the page of xmlPath is written (if it is currently saved).
+/// </summary>
+void PageData::waitForSave(const QString & xmlPath) {
+
+	auto it = mPendingSaves.find(xmlPath);
+
+	if (it == mPendingSaves.end())
+		return;
+
+	it.value().waitForFinished();
+	mPendingSaves.erase(it);
+
+	// we wrote the file - so the cached page is still up-to-date
+	if (mCache.contains(xmlPath))
+		mCache[xmlPath].modified = QFileInfo(xmlPath).lastModified();
+}
+
+/// <summary>
+/// Blocks until all pending saves are written.
+/// Saves serialize the page in the background, so call this before the page is edited.
+/// </summary>
+void PageData::waitForSaves() {
+
+	for (const QString& p : mPendingSaves.keys())
+		waitForSave(p);
+}
+
+void PageData::setPage(QSharedPointer<rdf::PageElement> page) {
+
+	mPage = page;
+	mDirty = false;
+	invalidateIndex();
+
+	if (mPage) {
+		addToCache(mRequestedPath, mPage);
+		qDebug() << "filename: " << mPage->imageFileName();
+	}
 
 	emit updatePage(mPage);
 }
 
+void PageData::load(const QString & xmlPath) {
+
+	if (mPendingLoads.contains(xmlPath))
+		return;
+
+	auto watcher = new QFutureWatcher<QSharedPointer<rdf::PageElement> >(this);
+
+	connect(watcher, &QFutureWatcher<QSharedPointer<rdf::PageElement> >::finished, this, [this, watcher, xmlPath]() {
+
+		auto page = watcher->result();
+		watcher->deleteLater();
+		mPendingLoads.remove(xmlPath);
+
+		addToCache(xmlPath, page);
+
+		// is the user waiting for this page?
+		if (!mPage && xmlPath == mRequestedPath)
+			setPage(page);
+	});
+
+	auto future = QtConcurrent::run([xmlPath]() {
+
+		rdf::PageXmlParser parser;
+		parser.read(xmlPath);
+		return parser.page();
+	});
+
+	mPendingLoads.insert(xmlPath, future);
+	watcher->setFuture(future);
+}
+
+void PageData::addToCache(const QString & xmlPath, QSharedPointer<rdf::PageElement> page) {
+
+	if (!page)
+		return;
+
+	CachedPage cp;
+	cp.page = page;
+	cp.modified = QFileInfo(xmlPath).lastModified();
+
+	mCache.insert(xmlPath, cp);
+	mCacheOrder.removeAll(xmlPath);
+	mCacheOrder.prepend(xmlPath);
+
+	while (mCacheOrder.size() > mCacheSize)
+		mCache.remove(mCacheOrder.takeLast());
+}
+
+/// <summary>
+/// Returns the cached page or a null pointer if the page is not cached
+/// or the XML was changed by someone else in the meantime.
+/// </summary>
+QSharedPointer<rdf::PageElement> PageData::cachedPage(const QString & xmlPath) {
+
+	auto it = mCache.find(xmlPath);
+
+	if (it == mCache.end())
+		return QSharedPointer<rdf::PageElement>();
+
+	if (it.value().modified != QFileInfo(xmlPath).lastModified()) {
+		mCache.erase(it);
+		mCacheOrder.removeAll(xmlPath);
+		return QSharedPointer<rdf::PageElement>();
+	}
+
+	mCacheOrder.removeAll(xmlPath);
+	mCacheOrder.prepend(xmlPath);
+
+	return it.value().page;
+}
+
+void PageData::cleanSaves() {
+
+	for (const QString& p : mPendingSaves.keys()) {
+
+		if (mPendingSaves[p].isFinished())
+			waitForSave(p);
+	}
+}
+
 void PageData::loadSettings(QSettings& settings, const QString& name) {
 
 	settings.beginGroup(objectName());
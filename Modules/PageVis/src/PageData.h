@@ -33,15 +33,32 @@
 #pragma once
 
 #include "ElementsHelper.h"
+#include "RegionIndex.h"
 
 #pragma warning(push, 0)	// no warnings from includes
 #include <QObject>
+#include <QMap>
+#include <QHash>
+#include <QDateTime>
+#include <QFuture>
 #pragma warning(pop)
 
 // Qt defines
 
 namespace rdm {
 
+/// <summary>
+/// Simplified geometry of a region for a given zoom level.
+/// </summary>
+struct LodRegion {
+	QSharedPointer<rdf::Region> region;
+	QPolygonF polygon;
+	QPolygonF baseLine;
+	QRectF box;
+	double lineHeight = 0;		// height of its text lines (image px)
+	bool collapsed = false;		// true if the region is too small & drawn as box
+};
+
 // read defines
 class PageData : public QObject {
 	Q_OBJECT
@@ -53,6 +70,14 @@ public:
 	QVector<QSharedPointer<rdf::RegionTypeConfig> > config() const;
 	QSharedPointer<rdf::PageElement> page() const;
 	QString xmlPath() const;
+	QSharedPointer<RegionIndex> regionIndex() const;
+	QVector<LodRegion> lodRegions(int zoomBucket) const;
+
+	static int zoomBucket(double scale);
+
+	bool isDirty() const;
+	void prefetch(const QStringList& xmlPaths);
+	void waitForSave(const QString& xmlPath);
 
 public slots:
 	void parse(const QString& xmlPath);
@@ -61,6 +86,10 @@ public slots:
 	void saveConfig(const QString& name) const;
 	void setXmlPath(const QString& path);
 	void deleteSelected();
+	void setDirty(bool dirty = true);
+	void invalidateIndex();
+	void regionChanged();
+	void waitForSaves();
 	QSharedPointer<rdf::Region> addRegion(const QRectF& rect, const rdf::Region::Type& type = rdf::Region::Type::type_text_region);
 
 signals:
@@ -72,6 +101,32 @@ private:
 	QVector<QSharedPointer<rdf::RegionTypeConfig> > mConfig;
 	QSharedPointer<rdf::PageElement> mPage;
 	QString mXmlPath;
+	mutable QSharedPointer<RegionIndex> mIndex;		// built lazily
+	mutable QMap<int, QVector<LodRegion> > mLod;	// simplified regions per zoom bucket
+
+	// parsed pages (LRU)
+	struct CachedPage {
+		QSharedPointer<rdf::PageElement> page;
+		QDateTime modified;		// of the XML when it was parsed/saved
+	};
+
+	QHash<QString, CachedPage> mCache;
+	QStringList mCacheOrder;				// most recently used first
+	int mCacheSize = 10;
+
+	QString mRequestedPath;					// the page we are waiting for
+	bool mDirty = false;					// true if mPage was modified
+	QHash<QString, QFuture<QSharedPointer<rdf::PageElement> > > mPendingLoads;
+	QHash<QString, QFuture<void> > mPendingSaves;			// the writers read the page - so edits wait for them
+
+	void setPage(QSharedPointer<rdf::PageElement> page);
+	void load(const QString& xmlPath);
+	void addToCache(const QString& xmlPath, QSharedPointer<rdf::PageElement> page);
+	QSharedPointer<rdf::PageElement> cachedPage(const QString& xmlPath);
+	void cleanSaves();
+
+	static bool writePage(QSharedPointer<rdf::PageElement> page, const QString& xmlPath);
+	static double lineHeight(QSharedPointer<rdf::Region> region);
 
 	void loadSettings(QSettings& settings, const QString& name);
 	void saveSettings(QSettings& settings, const QString& name) const;
@@ -952,7 +952,13 @@ void RegionEditWidget::on_regionCombo_currentTextChanged(const QString & text) {
 	rdf::Region::Type rt = rdf::RegionManager::instance().type(text);
 
 	if (mSelectedRegion) {
-		mSelectedRegion->setType(rt);
+
+		if (mSelectedRegion->type() != rt) {
+			emit regionAboutToChangeSignal();
+			mSelectedRegion->setType(rt);
+			emit regionChangedSignal();
+		}
+
 		emit updateSignal();
 	}
 
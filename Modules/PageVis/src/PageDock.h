@@ -286,6 +286,8 @@ signals:
 	void updateSignal() const;
 	void deleteSelectedSignal() const;
 	void addRegionSignal(bool) const;
+	void regionAboutToChangeSignal() const;
+	void regionChangedSignal() const;
 
 protected:
 	void createLayout();
@@ -46,6 +46,10 @@
 
 #pragma warning(push, 0)	// no warnings from includes
 #include <QPaintEvent>
+#include <QPainter>
+#include <QtMath>
+#include <QDir>
+#include <QImageReader>
 #include <QSettings>
 #pragma warning(pop)
 
@@ -77,13 +81,16 @@ void PageViewport::init() {
 	mPageData = new PageData(this);
 	mPageDock = new PageDock(mPageData, tr("Page Visualization"), this);
 	
-	connect(mPageData, SIGNAL(updatePage(QSharedPointer<rdf::PageElement>)), this, SLOT(update()));
+	connect(mPageData, SIGNAL(updatePage(QSharedPointer<rdf::PageElement>)), this, SLOT(updateRegions()));
+	connect(mPageData, SIGNAL(updatePage(QSharedPointer<rdf::PageElement>)), this, SLOT(checkPage(QSharedPointer<rdf::PageElement>)));
 	connect(mPageData, SIGNAL(updateXml()), this, SLOT(parseXml()));
-	connect(mPageDock, SIGNAL(updateSignal()), this, SLOT(update()));
+	connect(mPageDock, SIGNAL(updateSignal()), this, SLOT(updateRegions()));
 	connect(mPageDock, SIGNAL(closeSignal()), this, SIGNAL(closePlugin()));
 	connect(this, SIGNAL(selectRegionsSignal(const QVector<QSharedPointer<rdf::Region> >&)), mPageDock->regionWidget(), SLOT(setRegions(const QVector<QSharedPointer<rdf::Region> >&)));
 	connect(this, SIGNAL(selectRegionsSignal(const QVector<QSharedPointer<rdf::Region> >&)), mPageDock->regionEditWidget(), SLOT(setRegions(const QVector<QSharedPointer<rdf::Region> >&)));
 	connect(mPageDock->regionEditWidget(), SIGNAL(deleteSelectedSignal()), mPageData, SLOT(deleteSelected()));
+	connect(mPageDock->regionEditWidget(), SIGNAL(regionAboutToChangeSignal()), mPageData, SLOT(waitForSaves()));
+	connect(mPageDock->regionEditWidget(), SIGNAL(regionChangedSignal()), mPageData, SLOT(regionChanged()));
 	connect(mPageDock->regionEditWidget(), SIGNAL(addRegionSignal(bool)), this, SLOT(setAddRegionMode(bool)));
 	connect(this, SIGNAL(addRegionModeSignal(bool)), mPageDock->regionEditWidget(), SLOT(toggleAddRegion(bool)));
 }
@@ -149,16 +156,27 @@ void PageViewport::mouseMoveEvent(QMouseEvent * event) {
 
 void PageViewport::selectRegion(QMouseEvent * event) {
 
+	// still loading?
+	if (!mPageData->page())
+		return;
+
 	const rdf::RegionManager& rm = rdf::RegionManager::instance();
+	auto config = mPageData->config();
 
 	QPointF p = mapToImage(event->pos());
-	QVector<QSharedPointer<rdf::Region> > sr = 
-		rm.regionsAt(mPageData->page()->rootRegion(), p.toPoint(), mPageData->config());
+	QVector<QSharedPointer<rdf::Region> > sr;
+
+	// only select regions that are visible
+	for (auto r : mPageData->regionIndex()->regionsAt(p)) {
+
+		if (r->type() < config.size() && config[r->type()]->draw())
+			sr << r;
+	}
 
 	// select the region
 	rm.selectRegions(sr, mPageData->page()->rootRegion());
 	emit selectRegionsSignal(sr);
-	update();
+	updateRegions();
 
 	qDebug() << "#regions:" << sr.size() << "point:" << p;
 
@@ -166,6 +184,12 @@ void PageViewport::selectRegion(QMouseEvent * event) {
 
 void PageViewport::addRegion() {
 
+	// still loading?
+	if (!mPageData->page()) {
+		mNewRegion = QRectF();
+		return;
+	}
+
 	auto nr = mPageData->addRegion(mNewRegion, mPageDock->regionEditWidget()->currentRegion());	// TODO: change - for now this is convenience for sarah/max
 	QVector<QSharedPointer<rdf::Region> > regions;
 	regions << nr;
@@ -176,7 +200,7 @@ void PageViewport::addRegion() {
 
 	mNewRegion = QRectF();
 	mAddRegion = false;
-	update();
+	updateRegions();
 
 	emit addRegionModeSignal(false);
 }
@@ -184,7 +208,7 @@ void PageViewport::addRegion() {
 void PageViewport::updateImageContainer(QSharedPointer<nmc::DkImageContainerT> imgC) {
 
 	if (mPageData) {
-		// save current xml
+		// save current xml (if it was modified)
 		mPageData->save();
 	}
 
@@ -195,6 +219,7 @@ void PageViewport::updateImageContainer(QSharedPointer<nmc::DkImageContainerT> i
 		return;
 
 	parseXml();
+	prefetchNeighbors();
 
 	qDebug() << "plugin receives new image: " << imgC->fileName();
 }
@@ -204,22 +229,162 @@ void PageViewport::parseXml() {
 	if (!mImg)
 		return;
 
-	QString rawPath = mImg->filePath();
+	// the page might be loaded in the background - see checkPage()
+	mPageData->parse(xmlPathFromImage(mImg->filePath()));
+}
 
-	// prefer the specified folder if it is not empty
-	if (!mPageData->xmlPath().isEmpty())
-		rawPath = QFileInfo(mPageData->xmlPath(), mImg->fileName()).absoluteFilePath();
+/// <summary>
+/// Warns (once per XML) if the page does not belong to the current image.
+/// </summary>
+void PageViewport::checkPage(QSharedPointer<rdf::PageElement> page) {
 
-	QString xmlPath = rdf::PageXmlParser::imagePathToXmlPath(rawPath);
-	mPageData->parse(xmlPath);
+	if (!page || !mImg || page->xmlPath() == mCheckedXml)
+		return;
+
+	mCheckedXml = page->xmlPath();
 
-	QFileInfo xmlImageInfo(mPageData->page()->imageFileName());
-	if (!mPageData->page()->isEmpty() && xmlImageInfo.baseName() != mImg->fileInfo().baseName()) {
+	QFileInfo xmlImageInfo(page->imageFileName());
+	if (!page->isEmpty() && xmlImageInfo.baseName() != mImg->fileInfo().baseName()) {
 		emit showInfo(tr("PAGE file does not correspond with the image displayed..."));
 		qDebug() << "NOTE" << xmlImageInfo.baseName() << "!=" << mImg->fileInfo().baseName();
 	}
 }
 
+QString PageViewport::xmlPathFromImage(const QString & imgPath) const {
+
+	QString rawPath = imgPath;
+
+	// prefer the specified folder if it is not empty
+	if (!mPageData->xmlPath().isEmpty())
+		rawPath = QFileInfo(mPageData->xmlPath(), QFileInfo(imgPath).fileName()).absoluteFilePath();
+
+	return rdf::PageXmlParser::imagePathToXmlPath(rawPath);
+}
+
+/// <summary>
+/// Parses the XMLs of the previous and next image in the background.
+/// </summary>
+void PageViewport::prefetchNeighbors() {
+
+	QFileInfo info = mImg->fileInfo();
+
+	// list the folder only once
+	if (mDirPath != info.absolutePath()) {
+
+		QStringList filters;
+		for (const QByteArray& f : QImageReader::supportedImageFormats())
+			filters << "*." + QString::fromLatin1(f);
+
+		mDirPath = info.absolutePath();
+		mDirFiles = QDir(mDirPath).entryList(filters, QDir::Files, QDir::Name | QDir::IgnoreCase);
+	}
+
+	int idx = mDirFiles.indexOf(info.fileName());
+	if (idx == -1)
+		return;
+
+	QStringList xmlPaths;
+	for (int nIdx : {idx + 1, idx - 1}) {
+
+		if (nIdx >= 0 && nIdx < mDirFiles.size())
+			xmlPaths << xmlPathFromImage(QFileInfo(mDirPath, mDirFiles[nIdx]).absoluteFilePath());
+	}
+
+	mPageData->prefetch(xmlPaths);
+}
+
+/// <summary>
+/// Invalidates the cached region drawing (e.g. if the page, selection or config changed).
+/// </summary>
+void PageViewport::updateRegions() {
+
+	mPictureDirty = true;
+	update();
+}
+
+/// <summary>
+/// Records all regions that are (close to) visible into the display list.
+/// The recorded area is larger than the visible rect so that panning
+/// and zooming in can replay it without re-recording.
+/// If we are zoomed out, regions are drawn with the simplified geometry
+/// of the current zoom bucket and text is hidden if it gets too small.
+/// </summary>
+/// <param name="visibleRect">The visible rect in image coordinates.</param>
+/// <param name="scale">The current scale (screen px / image px).</param>
+void PageViewport::updatePicture(const QRectF & visibleRect, double scale) {
+
+	rdf::Timer dt;
+
+	double mx = visibleRect.width() * 0.5;
+	double my = visibleRect.height() * 0.5;
+	mPictureRect = visibleRect.adjusted(-mx, -my, mx, my);
+	mPictureScale = scale;
+
+	auto root = mPageData->page()->rootRegion();
+	int nSel = root->selectedRegions().size();
+	auto config = mPageData->config();
+
+	int bucket = PageData::zoomBucket(scale);
+
+	mPicture = QPicture();
+	QPainter p(&mPicture);
+
+	// draw everything if we are zoomed in (or the user selected regions)
+	if (bucket >= 0 || nSel > 0) {
+
+		QVector<QSharedPointer<rdf::Region> > regions = mPageData->regionIndex()->regionsIn(mPictureRect);
+
+		for (auto r : regions)
+			rdf::RegionManager::instance().drawRegion(p, r, config, false, nSel > 0);
+
+		qDebug() << regions.size() << "regions recorded in" << dt;
+	}
+	else {
+
+		// text smaller than this (screen px) is not drawn
+		const double minTextHeight = 8.0;
+		int cnt = 0;
+
+		for (const LodRegion& lr : mPageData->lodRegions(bucket)) {
+
+			if (!lr.box.intersects(mPictureRect))
+				continue;
+
+			if (lr.region->type() >= config.size())
+				continue;
+
+			auto c = config[lr.region->type()];
+			if (!c->draw())
+				continue;
+
+			// large enough to read the text? - then we draw the region as is
+			if (c->drawText() && !lr.collapsed && lr.lineHeight * scale >= minTextHeight) {
+				rdf::RegionManager::instance().drawRegion(p, lr.region, config, false);
+				cnt++;
+				continue;
+			}
+
+			p.setPen(c->pen());
+			p.setBrush(c->brush());
+
+			if (lr.collapsed)
+				p.drawRect(lr.box);
+			else if (c->drawPoly())
+				p.drawPolygon(lr.polygon);
+
+			if (c->drawBaseline() && !lr.baseLine.isEmpty())
+				p.drawPolyline(lr.baseLine);
+
+			cnt++;
+		}
+
+		qDebug() << cnt << "simplified regions recorded in" << dt;
+	}
+
+	p.end();
+	mPictureDirty = false;
+}
+
 PageDock * PageViewport::dock() const {
 	return mPageDock;
 }
@@ -239,13 +404,23 @@ void PageViewport::paintEvent(QPaintEvent* event) {
 
 	if (mPageDock->drawRegions()) {
 
-		if (mWorldMatrix)
-			painter.setWorldTransform((*mImgMatrix) * (*mWorldMatrix));	// >DIR: using both matrices allows for correct resizing [16.10.2013 markus]
+		QTransform wt;
+		if (mWorldMatrix) {
+			wt = (*mImgMatrix) * (*mWorldMatrix);	// >DIR: using both matrices allows for correct resizing [16.10.2013 markus]
+			painter.setWorldTransform(wt);
+		}
 
 		if (mPageData->page() && !mPageData->page()->isEmpty()) {
-			auto root = mPageData->page()->rootRegion();
-			int nSel = root->selectedRegions().size();
-			rdf::RegionManager::instance().drawRegion(painter, root, mPageData->config(), true, nSel > 0);
+
+			// only re-record if something changed or we left the recorded area
+			QRectF visibleRect = wt.inverted().mapRect(QRectF(rect()));
+			// the zoom bucket changes the level of detail
+			double scale = qSqrt(qAbs(wt.determinant()));
+			if (mPictureDirty || !mPictureRect.contains(visibleRect) || 
+				PageData::zoomBucket(scale) != PageData::zoomBucket(mPictureScale))
+				updatePicture(visibleRect, scale);
+
+			painter.drawPicture(0, 0, mPicture);
 		}
 	}
 
@@ -37,7 +37,7 @@
 #include "Elements.h"
 
 #pragma warning(push, 0)	// no warnings from includes
-// Qt Includes
+#include <QPicture>
 #pragma warning(pop)
 
 // Qt defines
@@ -72,6 +72,8 @@ signals:
 public slots:
 	void parseXml();
 	void setAddRegionMode(bool add = true);
+	void updateRegions();
+	void checkPage(QSharedPointer<rdf::PageElement> page);
 
 private:
 	void init();
@@ -87,13 +89,26 @@ private:
 
 	void selectRegion(QMouseEvent* event);
 	void addRegion();
+	void updatePicture(const QRectF& visibleRect, double scale);
+	QString xmlPathFromImage(const QString& imgPath) const;
+	void prefetchNeighbors();
 
 	PageDock* mPageDock = 0;
 	PageData* mPageData = 0;
 	QSharedPointer<nmc::DkImageContainerT> mImg;
 
+	QString mCheckedXml;
+	QString mDirPath;					// folder of mDirFiles
+	QStringList mDirFiles;				// images of the current folder (for prefetching)
+
 	bool mAddRegion = false;
 	QRectF mNewRegion;
+
+	// cached region drawing (in image coordinates)
+	QPicture mPicture;
+	QRectF mPictureRect;
+	double mPictureScale = 1.0;
+	bool mPictureDirty = true;
 };
 
 };
\ No newline at end of file
@@ -0,0 +1,192 @@
+/*******************************************************************************************************
+ ReadFramework is the basis for modules developed at CVL/TU Wien for the EU project READ. 
+  
+ Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+ Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+ Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+ This file is part of ReadFramework.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020  
+ research  and innovation programme under grant agreement No 674943
+ 
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#include "RegionIndex.h"
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QDebug>
+#include <QtMath>
+
+#include <algorithm>
+#pragma warning(pop)
+
+namespace rdm {
+
+// RegionIndex --------------------------------------------------------------------
+RegionIndex::RegionIndex(QSharedPointer<rdf::Region> root) {
+
+	if (!root)
+		return;
+
+	for (auto r : root->allRegions()) {
+
+		Entry e;
+		e.region = r;
+		e.polygon = r->polygon().closedPolygon();
+		e.box = e.polygon.boundingRect();
+
+		// lines might only have a baseline
+		QPolygonF bl;
+		auto tl = r.dynamicCast<rdf::TextLine>();
+		if (tl)
+			bl = tl->baseLine().polygon().polygon();
+
+		if (e.polygon.isEmpty() && bl.isEmpty())
+			continue;
+
+		e.box = e.box.united(bl.boundingRect());
+
+		// flat lines (e.g. horizontal baselines) have no area - QRectF::intersects would never match
+		if (e.box.width() < 1.0 || e.box.height() < 1.0)
+			e.box.adjust(-1, -1, 1, 1);
+
+		mBounds = mBounds.united(e.box);
+		mEntries << e;
+	}
+
+	if (mEntries.empty())
+		return;
+
+	// on average, a cell holds a few regions
+	mCellSize = qMax(16.0, qSqrt(mBounds.width() * mBounds.height() / mEntries.size()) * 2.0);
+	mCols = qMax(1, qCeil(mBounds.width() / mCellSize));
+	mRows = qMax(1, qCeil(mBounds.height() / mCellSize));
+	mCells.resize(mCols * mRows);
+
+	for (int idx = 0; idx < mEntries.size(); idx++) {
+
+		QRect cr = cellRange(mEntries[idx].box);
+
+		for (int y = cr.top(); y <= cr.bottom(); y++)
+			for (int x = cr.left(); x <= cr.right(); x++)
+				mCells[y * mCols + x] << idx;
+	}
+}
+
+bool RegionIndex::isEmpty() const {
+	return mEntries.empty();
+}
+
+int RegionIndex::size() const {
+	return mEntries.size();
+}
+
+/// <summary>
+/// Returns all regions whose polygon contains point.
+/// </summary>
+QVector<QSharedPointer<rdf::Region> > RegionIndex::regionsAt(const QPointF & point) const {
+
+	QVector<QSharedPointer<rdf::Region> > regions;
+
+	for (int idx : candidates(QRectF(point, QSizeF(0, 0)))) {
+
+		const Entry& e = mEntries[idx];
+		// regions without area are hit by their (inflated) box
+		if (e.box.contains(point) && (e.polygon.size() < 3 || e.polygon.containsPoint(point, Qt::OddEvenFill)))
+			regions << e.region;
+	}
+
+	return regions;
+}
+
+/// <summary>
+/// Returns all regions whose bounding box intersects rect.
+/// </summary>
+QVector<QSharedPointer<rdf::Region> > RegionIndex::regionsIn(const QRectF & rect) const {
+
+	QVector<QSharedPointer<rdf::Region> > regions;
+
+	for (int idx : candidates(rect)) {
+
+		if (mEntries[idx].box.intersects(rect))
+			regions << mEntries[idx].region;
+	}
+
+	return regions;
+}
+
+/// <summary>
+/// Returns all regions whose polygon intersects polygon.
+/// </summary>
+QVector<QSharedPointer<rdf::Region> > RegionIndex::regionsIn(const QPolygonF & polygon) const {
+
+	QVector<QSharedPointer<rdf::Region> > regions;
+	QRectF box = polygon.boundingRect();
+
+	for (int idx : candidates(box)) {
+
+		const Entry& e = mEntries[idx];
+
+		if (!e.box.intersects(box))
+			continue;
+
+		if ((box.contains(e.box) && polygon.containsPoint(e.box.center(), Qt::OddEvenFill)) ||
+			!(e.polygon.size() < 3 ? QPolygonF(e.box) : e.polygon).intersected(polygon).isEmpty())
+			regions << e.region;
+	}
+
+	return regions;
+}
+
+QRect RegionIndex::cellRange(const QRectF & rect) const {
+
+	int x0 = qBound(0, qFloor((rect.left() - mBounds.left()) / mCellSize), mCols - 1);
+	int y0 = qBound(0, qFloor((rect.top() - mBounds.top()) / mCellSize), mRows - 1);
+	int x1 = qBound(0, qFloor((rect.right() - mBounds.left()) / mCellSize), mCols - 1);
+	int y1 = qBound(0, qFloor((rect.bottom() - mBounds.top()) / mCellSize), mRows - 1);
+
+	return QRect(QPoint(x0, y0), QPoint(x1, y1));
+}
+
+/// <summary>
+/// Returns the (sorted & unique) entry indexes of all cells touched by rect.
+/// </summary>
+QVector<int> RegionIndex::candidates(const QRectF & rect) const {
+
+	QVector<int> idxs;
+
+	if (mEntries.empty() || !rect.normalized().adjusted(-1, -1, 1, 1).intersects(mBounds))
+		return idxs;
+
+	QRect cr = cellRange(rect.normalized());
+
+	for (int y = cr.top(); y <= cr.bottom(); y++)
+		for (int x = cr.left(); x <= cr.right(); x++)
+			idxs << mCells[y * mCols + x];
+
+	std::sort(idxs.begin(), idxs.end());
+	idxs.erase(std::unique(idxs.begin(), idxs.end()), idxs.end());
+
+	return idxs;
+}
+
+}
@@ -0,0 +1,82 @@
+/*******************************************************************************************************
+ ReadFramework is the basis for modules developed at CVL/TU Wien for the EU project READ. 
+  
+ Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+ Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+ Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+ This file is part of ReadFramework.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020  
+ research  and innovation programme under grant agreement No 674943
+ 
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#pragma once
+
+#include "Elements.h"
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QRectF>
+#include <QPolygonF>
+#include <QVector>
+#include <QSharedPointer>
+#pragma warning(pop)
+
+namespace rdm {
+
+/// <summary>
+/// Uniform grid over all regions of a page.
+/// Point, rectangle and polygon queries only test regions
+/// whose bounding box falls into the cells touched.
+/// Results are returned in document order.
+/// </summary>
+class RegionIndex {
+
+public:
+	RegionIndex(QSharedPointer<rdf::Region> root = QSharedPointer<rdf::Region>());
+
+	bool isEmpty() const;
+	int size() const;
+
+	QVector<QSharedPointer<rdf::Region> > regionsAt(const QPointF& point) const;
+	QVector<QSharedPointer<rdf::Region> > regionsIn(const QRectF& rect) const;
+	QVector<QSharedPointer<rdf::Region> > regionsIn(const QPolygonF& polygon) const;
+
+private:
+	struct Entry {
+		QSharedPointer<rdf::Region> region;
+		QRectF box;
+		QPolygonF polygon;
+	};
+
+	QVector<Entry> mEntries;
+	QVector<QVector<int> > mCells;
+	QRectF mBounds;
+	double mCellSize = 1.0;
+	int mCols = 0;
+	int mRows = 0;
+
+	QRect cellRange(const QRectF& rect) const;
+	QVector<int> candidates(const QRectF& rect) const;
+};
+
+};
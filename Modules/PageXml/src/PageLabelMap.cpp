@@ -0,0 +1,174 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#include "PageLabelMap.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QDebug>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QThread>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+// PageLabelMap --------------------------------------------------------------------
+PageLabelMap::PageLabelMap(const QSize& size, int background) {
+	mSize = size;
+	mBackground = background;
+	mMaxLabel = background;
+}
+
+void PageLabelMap::addRegion(const QPolygonF & polygon, int label) {
+
+	if (polygon.size() < 3)
+		return;
+
+	std::vector<cv::Point> pts;
+	pts.reserve(polygon.size());
+
+	for (const QPointF& p : polygon)
+		pts.push_back(cv::Point(qRound(p.x()), qRound(p.y())));
+
+	mBoxes << cv::boundingRect(pts);
+	mPolygons << pts;
+	mLabels << label;
+	mMaxLabel = qMax(mMaxLabel, label);
+}
+
+/// <summary>
+/// Renders the label map.
+/// It is CV_8UC1 if all labels are < 256 and CV_16UC1 otherwise.
+/// The map is split into horizontal bands that are filled in parallel
+/// so that overlapping regions keep their (document) order.
+/// </summary>
+cv::Mat PageLabelMap::render() const {
+
+	int type = mMaxLabel < 256 ? CV_8UC1 : CV_16UC1;
+	cv::Mat labelMap(mSize.height(), mSize.width(), type, cv::Scalar(mBackground));
+
+	if (labelMap.empty())
+		return labelMap;
+
+	int numBands = qMax(1, QThread::idealThreadCount() * 2);
+	int bandHeight = (labelMap.rows + numBands - 1) / numBands;
+
+	cv::parallel_for_(cv::Range(0, numBands), [&](const cv::Range& range) {
+
+		for (int bIdx = range.start; bIdx < range.end; bIdx++) {
+
+			cv::Rect band(0, bIdx * bandHeight, labelMap.cols, bandHeight);
+			band &= cv::Rect(0, 0, labelMap.cols, labelMap.rows);
+
+			if (band.empty())
+				continue;
+
+			// a view - we write directly to the label map
+			cv::Mat bMap = labelMap(band);
+
+			for (int idx = 0; idx < mPolygons.size(); idx++) {
+
+				if ((mBoxes[idx] & band).empty())
+					continue;
+
+				const cv::Point* pts = mPolygons[idx].data();
+				int n = (int)mPolygons[idx].size();
+				cv::fillPoly(bMap, &pts, &n, 1, cv::Scalar(mLabels[idx]), cv::LINE_8, 0, cv::Point(0, -band.y));
+			}
+		}
+	});
+
+	return labelMap;
+}
+
+/// <summary>
+/// Writes the label map.
+/// If the suffix is npy, a raw numpy array is written.
+/// Otherwise, the file format is chosen by OpenCV (e.g. 8/16 bit png).
+/// </summary>
+/// <returns>true on success.</returns>
+bool PageLabelMap::write(const QString & filePath, const cv::Mat& labelMap) const {
+
+	if (QFileInfo(filePath).suffix().toLower() == "npy")
+		return writeNpy(filePath, labelMap);
+
+	return cv::imwrite(filePath.toStdString(), labelMap);
+}
+
+/// <summary>
+/// Converts the label map to an 8 bit image with spread labels (for visualization only).
+/// </summary>
+cv::Mat PageLabelMap::toVisualization(const cv::Mat & labelMap) {
+
+	double maxLabel = 0;
+	cv::minMaxLoc(labelMap, 0, &maxLabel);
+
+	cv::Mat vis;
+	labelMap.convertTo(vis, CV_8UC1, maxLabel > 0 ? 255.0 / maxLabel : 1.0);
+
+	return vis;
+}
+
+bool PageLabelMap::writeNpy(const QString & filePath, const cv::Mat & labelMap) const {
+
+	QString descr = labelMap.depth() == CV_8U ? "|u1" : "<u2";
+	QByteArray header = QString("{'descr': '%1', 'fortran_order': False, 'shape': (%2, %3), }")
+		.arg(descr).arg(labelMap.rows).arg(labelMap.cols).toLatin1();
+
+	// the header (incl. magic & length) is padded to 64 bytes
+	const int preambleSize = 10;
+	int total = preambleSize + header.size() + 1;
+	header += QByteArray((64 - total % 64) % 64, ' ');
+	header += '\n';
+
+	QSaveFile f(filePath);
+
+	if (!f.open(QIODevice::WriteOnly))
+		return false;
+
+	quint16 headerSize = (quint16)header.size();
+
+	f.write("\x93NUMPY", 6);
+	f.write("\x01\x00", 2);
+	f.write((const char*)&headerSize, sizeof(headerSize));	// little endian
+	f.write(header);
+
+	for (int rIdx = 0; rIdx < labelMap.rows; rIdx++)
+		f.write((const char*)labelMap.ptr(rIdx), labelMap.cols * labelMap.elemSize());
+
+	return f.commit();
+}
+
+}
@@ -0,0 +1,74 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QString>
+#include <QSize>
+#include <QPolygonF>
+#include <QVector>
+#include <opencv2/core.hpp>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+/// <summary>
+/// Indexed label map of a PAGE document.
+/// Region polygons are scanline filled with their label id.
+/// Later regions overwrite earlier ones (i.e. document order).
+/// </summary>
+class PageLabelMap {
+
+public:
+	PageLabelMap(const QSize& size = QSize(), int background = 0);
+
+	void addRegion(const QPolygonF& polygon, int label);
+
+	cv::Mat render() const;
+	bool write(const QString& filePath, const cv::Mat& labelMap) const;
+
+	static cv::Mat toVisualization(const cv::Mat& labelMap);
+
+private:
+	QSize mSize;
+	int mBackground = 0;
+	int mMaxLabel = 0;
+
+	QVector<std::vector<cv::Point> > mPolygons;
+	QVector<cv::Rect> mBoxes;
+	QVector<int> mLabels;
+
+	bool writeNpy(const QString& filePath, const cv::Mat& labelMap) const;
+};
+
+};
@@ -0,0 +1,357 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#include "PageXmlCache.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QHash>
+#include <QDateTime>
+
+#include <cstring>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+// the sidecar layout is:
+// Header | points (double x,y) | CacheRegion[] | string offsets (quint32[numStrings+1]) | utf-8 strings
+namespace {
+
+	const char cacheMagic[4] = {'R', 'D', 'M', 'P'};
+	const quint32 cacheVersion = 1;
+
+	struct CacheHeader {
+		char magic[4];
+		quint32 version;
+		qint64 xmlModified;		// msecs since epoch
+		qint64 xmlSize;
+		qint32 imageWidth;
+		qint32 imageHeight;
+		quint32 imageFileName;	// string index
+		quint32 numStrings;
+		quint32 numRegions;
+		quint32 numPoints;
+	};
+
+	struct CacheRegion {
+		quint32 type;			// string index
+		quint32 id;				// string index
+		qint32 depth;
+		quint32 polyStart;
+		quint32 polyCount;
+		quint32 baseLineStart;
+		quint32 baseLineCount;
+	};
+}
+
+// PageXmlCache --------------------------------------------------------------------
+PageXmlCache::PageXmlCache(const QString& xmlPath, bool enabled) {
+	mXmlPath = xmlPath;
+	mEnabled = enabled;
+}
+
+/// <summary>
+/// Visits all regions of the PAGE XML.
+/// If a valid sidecar exists, the regions are read from it.
+/// Otherwise, the XML is streamed and the sidecar is (re)written.
+/// If the cache is disabled, this is equal to PageXmlStreamReader::read.
+/// </summary>
+/// <param name="visitor">The visitor.</param>
+/// <returns>true if the regions were read successfully.</returns>
+bool PageXmlCache::read(std::function<void(const PageXmlRegion&)> visitor) {
+
+	if (mEnabled && isValid() && readCache(visitor))
+		return true;
+
+	PageXmlStreamReader reader(mXmlPath);
+	QVector<PageXmlRegion> regions;
+
+	bool ok = reader.read([&](const PageXmlRegion& r) {
+
+		if (mEnabled)
+			regions << r;
+		visitor(r);
+	});
+
+	mImageFileName = reader.imageFileName();
+	mImageSize = reader.imageSize();
+
+	if (!ok) {
+		mError = reader.errorString();
+		return false;
+	}
+
+	if (mEnabled && !write(regions))
+		qWarning() << "could not write PAGE cache for" << mXmlPath;
+
+	return true;
+}
+
+/// <summary>
+/// Writes the sidecar for the current XML.
+/// </summary>
+/// <param name="regions">All regions in document order.</param>
+/// <returns>true on success.</returns>
+bool PageXmlCache::write(const QVector<PageXmlRegion>& regions) const {
+
+	QFileInfo xmlInfo(mXmlPath);
+
+	if (!xmlInfo.exists())
+		return false;
+
+	// build the string table
+	QVector<QByteArray> strings;
+	QHash<QString, quint32> stringIdx;
+
+	auto addString = [&](const QString& str) -> quint32 {
+		
+		auto it = stringIdx.find(str);
+		if (it != stringIdx.end())
+			return it.value();
+
+		quint32 idx = (quint32)strings.size();
+		strings << str.toUtf8();
+		stringIdx.insert(str, idx);
+
+		return idx;
+	};
+
+	QVector<double> points;
+	QVector<CacheRegion> cRegions;
+	cRegions.reserve(regions.size());
+
+	auto addPoints = [&](const QPolygonF& poly) -> quint32 {
+
+		quint32 start = (quint32)points.size() / 2;
+		for (const QPointF& pt : poly)
+			points << pt.x() << pt.y();
+
+		return start;
+	};
+
+	CacheHeader header;
+	memcpy(header.magic, cacheMagic, sizeof(header.magic));
+	header.version = cacheVersion;
+	header.xmlModified = xmlInfo.lastModified().toMSecsSinceEpoch();
+	header.xmlSize = xmlInfo.size();
+	header.imageWidth = mImageSize.width();
+	header.imageHeight = mImageSize.height();
+	header.imageFileName = addString(mImageFileName);
+
+	for (const PageXmlRegion& r : regions) {
+
+		CacheRegion cr;
+		cr.type = addString(r.type);
+		cr.id = addString(r.id);
+		cr.depth = r.depth;
+		cr.polyStart = addPoints(r.polygon);
+		cr.polyCount = (quint32)r.polygon.size();
+		cr.baseLineStart = addPoints(r.baseLine);
+		cr.baseLineCount = (quint32)r.baseLine.size();
+		cRegions << cr;
+	}
+
+	header.numStrings = (quint32)strings.size();
+	header.numRegions = (quint32)cRegions.size();
+	header.numPoints = (quint32)points.size() / 2;
+
+	QVector<quint32> offsets;
+	offsets.reserve(strings.size() + 1);
+	quint32 offset = 0;
+	for (const QByteArray& s : strings) {
+		offsets << offset;
+		offset += (quint32)s.size();
+	}
+	offsets << offset;
+
+	QSaveFile f(cachePath(mXmlPath));
+
+	if (!f.open(QIODevice::WriteOnly))
+		return false;
+
+	f.write((const char*)&header, sizeof(header));
+	f.write((const char*)points.constData(), points.size() * sizeof(double));
+	f.write((const char*)cRegions.constData(), cRegions.size() * sizeof(CacheRegion));
+	f.write((const char*)offsets.constData(), offsets.size() * sizeof(quint32));
+
+	for (const QByteArray& s : strings)
+		f.write(s);
+
+	return f.commit();
+}
+
+/// <summary>
+/// Returns true if a sidecar exists that was created from the current XML.
+/// </summary>
+bool PageXmlCache::isValid() const {
+
+	QFileInfo xmlInfo(mXmlPath);
+	QFile f(cachePath(mXmlPath));
+
+	if (!xmlInfo.exists() || !f.open(QIODevice::ReadOnly))
+		return false;
+
+	CacheHeader header;
+	if (f.read((char*)&header, sizeof(header)) != sizeof(header))
+		return false;
+
+	return memcmp(header.magic, cacheMagic, sizeof(header.magic)) == 0 &&
+		header.version == cacheVersion &&
+		header.xmlModified == xmlInfo.lastModified().toMSecsSinceEpoch() &&
+		header.xmlSize == xmlInfo.size();
+}
+
+bool PageXmlCache::readCache(std::function<void(const PageXmlRegion&)> visitor) {
+
+	QFile f(cachePath(mXmlPath));
+
+	if (!f.open(QIODevice::ReadOnly))
+		return false;
+
+	qint64 size = f.size();
+	if (size < (qint64)sizeof(CacheHeader))
+		return false;
+
+	const uchar* data = f.map(0, size);
+
+	if (!data) {
+		qWarning() << "could not map" << f.fileName();
+		return false;
+	}
+
+	CacheHeader header;
+	memcpy(&header, data, sizeof(header));
+
+	// check the file size before touching the data
+	qint64 pointsOffset = sizeof(CacheHeader);
+	qint64 regionsOffset = pointsOffset + (qint64)header.numPoints * 2 * sizeof(double);
+	qint64 offsetsOffset = regionsOffset + (qint64)header.numRegions * sizeof(CacheRegion);
+	qint64 stringsOffset = offsetsOffset + ((qint64)header.numStrings + 1) * sizeof(quint32);
+
+	if (stringsOffset > size) {
+		qWarning() << "corrupted PAGE cache:" << f.fileName();
+		return false;
+	}
+
+	const double* points = (const double*)(data + pointsOffset);
+	const CacheRegion* regions = (const CacheRegion*)(data + regionsOffset);
+	const quint32* offsets = (const quint32*)(data + offsetsOffset);
+
+	if (stringsOffset + offsets[header.numStrings] > size) {
+		qWarning() << "corrupted PAGE cache:" << f.fileName();
+		return false;
+	}
+
+	// offsets must be ascending - otherwise a string would point outside the table
+	for (quint32 idx = 0; idx < header.numStrings; idx++) {
+
+		if (offsets[idx] > offsets[idx+1]) {
+			qWarning() << "corrupted PAGE cache:" << f.fileName();
+			return false;
+		}
+	}
+
+	// decode the string table once - types are shared by many regions
+	QVector<QString> strings(header.numStrings);
+	for (quint32 idx = 0; idx < header.numStrings; idx++) {
+		strings[idx] = QString::fromUtf8(
+			(const char*)data + stringsOffset + offsets[idx], 
+			offsets[idx+1] - offsets[idx]);
+	}
+
+	auto string = [&](quint32 idx) {
+		return idx < header.numStrings ? strings[idx] : QString();
+	};
+
+	auto polygon = [&](quint32 start, quint32 count) {
+
+		QPolygonF poly;
+		if ((qint64)start + count > header.numPoints)
+			return poly;
+
+		poly.resize(count);
+		for (quint32 idx = 0; idx < count; idx++)
+			poly[idx] = QPointF(points[(start + idx) * 2], points[(start + idx) * 2 + 1]);
+
+		return poly;
+	};
+
+	mImageFileName = string(header.imageFileName);
+	mImageSize = QSize(header.imageWidth, header.imageHeight);
+
+	PageXmlRegion r;
+	for (quint32 idx = 0; idx < header.numRegions; idx++) {
+
+		const CacheRegion& cr = regions[idx];
+		r.type = string(cr.type);
+		r.id = string(cr.id);
+		r.depth = cr.depth;
+		r.polygon = polygon(cr.polyStart, cr.polyCount);
+		r.baseLine = polygon(cr.baseLineStart, cr.baseLineCount);
+
+		visitor(r);
+	}
+
+	return true;
+}
+
+QString PageXmlCache::xmlPath() const {
+	return mXmlPath;
+}
+
+QString PageXmlCache::imageFileName() const {
+	return mImageFileName;
+}
+
+/// <summary>
+/// Returns the image size of the Page element.
+/// It is valid once read() was called.
+/// </summary>
+QSize PageXmlCache::imageSize() const {
+	return mImageSize;
+}
+
+QString PageXmlCache::errorString() const {
+	return mError;
+}
+
+/// <summary>
+/// Returns the sidecar path (e.g. page/img.xml -> page/img.xml.rdmc).
+/// </summary>
+QString PageXmlCache::cachePath(const QString & xmlPath) {
+	return xmlPath + ".rdmc";
+}
+
+}
@@ -0,0 +1,80 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#pragma once
+
+#include "PageXmlStream.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QString>
+#include <QSize>
+#include <QVector>
+#include <functional>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+/// <summary>
+/// Binary sidecar of a PAGE XML.
+/// The sidecar stores flat polygon and baseline arrays together with
+/// a string table (types, ids) and is memory mapped when reading.
+/// It is only used if the XML's modification time and size match the
+/// recorded ones. NOTE: the cache is lossy (e.g. text and custom attributes are not stored)
+/// so it is meant for read-only (e.g. drawing) tasks only.
+/// </summary>
+class PageXmlCache {
+
+public:
+	PageXmlCache(const QString& xmlPath = QString(), bool enabled = true);
+
+	bool read(std::function<void(const PageXmlRegion&)> visitor);
+	bool write(const QVector<PageXmlRegion>& regions) const;
+	bool isValid() const;
+
+	QString xmlPath() const;
+	QString imageFileName() const;
+	QSize imageSize() const;
+	QString errorString() const;
+
+	static QString cachePath(const QString& xmlPath);
+
+private:
+	QString mXmlPath;
+	QString mImageFileName;
+	QSize mImageSize;
+	QString mError;
+	bool mEnabled = true;
+
+	bool readCache(std::function<void(const PageXmlRegion&)> visitor);
+};
+
+};
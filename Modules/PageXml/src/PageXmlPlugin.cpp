@@ -31,6 +31,10 @@ related links:
 *******************************************************************************************************/
 
 #include "PageXmlPlugin.h"
+#include "PageXmlValidator.h"
+#include "PageXmlStream.h"
+#include "PageXmlCache.h"
+#include "PageLabelMap.h"
 
 // ReadFramework
 #include "Settings.h"
@@ -38,6 +42,7 @@ related links:
 #include "Elements.h"
 #include "ElementsHelper.h"
 #include "SuperPixelTrainer.h"
+#include "Utils.h"
 
 // nomacs
 #include "DkImageStorage.h"
@@ -47,6 +52,14 @@ related links:
 #include <QAction>
 #include <QUuid>
 #include <QStandardPaths>
+#include <QFileInfo>
+#include <QSet>
+#include <QImageWriter>
+#include <QPainter>
+#include <QThread>
+#include <QtMath>
+#include <QTransform>
+#include <QtConcurrentMap>
 #pragma warning(pop)		// no warnings from includes - end
 
 namespace rdm {
@@ -70,6 +83,8 @@ PageXmlPlugin::PageXmlPlugin(QObject* parent) : QObject(parent) {
 	menuNames[id_page_drawer]		= tr("Draw Regions");
 	menuNames[id_page_validator]	= tr("Validate PAGE XMLs");
 	menuNames[id_page_to_gt]		= tr("Label Image from XML");
+	menuNames[id_page_validator_dir]	= tr("Validate PAGE XMLs in Folder");
+	menuNames[id_page_pipeline]		= tr("PAGE Pipeline");
 	mMenuNames = menuNames.toList();
 
 	// create menu status tips
@@ -80,6 +95,8 @@ PageXmlPlugin::PageXmlPlugin(QObject* parent) : QObject(parent) {
 	statusTips[id_page_drawer]		= tr("Draws the PAGE XML regions to the image using your last settings");
 	statusTips[id_page_validator]	= tr("Checks if the image has a valid PAGE XML");
 	statusTips[id_page_to_gt]		= tr("Renders a label image from a PAGE XML");
+	statusTips[id_page_validator_dir]	= tr("Checks all images in the current image's folder (without decoding the images)");
+	statusTips[id_page_pipeline]	= tr("Runs all operations specified in pipeline with a single XML parse/write");
 	mMenuStatusTips = statusTips.toList();
 
 	// save settings
@@ -101,51 +118,83 @@ void PageXmlPlugin::postLoadPlugin(const QVector<QSharedPointer<nmc::DkBatchInfo
 		return;
 
 	if (batchInfo.first()->id() == mRunIDs[id_page_validator]) {
+		writeValidatorLog(batchInfo);
+	}
+	else if (batchInfo.first()->id() == mRunIDs[id_page_validator_dir]) {
 
-		QString logPath(mConfig.validatorLog());
-
-		// create default log path
-		if (logPath.isEmpty()) {
-			QString td = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
-			QString ts = QDateTime::currentDateTime().toString("yyyy-MM-dd HH-mm-ss");
-			QString fn = tr("xml-validator-log-") + ts + ".txt";
-			logPath = QFileInfo(td, fn).absoluteFilePath();
+		// validate every folder only once
+		QStringList dirs;
+		for (auto bi : batchInfo) {
+			QString dir = QFileInfo(bi->filePath()).absolutePath();
+			if (!dirs.contains(dir))
+				dirs << dir;
 		}
 
-		QFile fh(logPath);
+		rdf::Timer dt;
+		QVector<QSharedPointer<nmc::DkBatchInfo> > infos;
+
+		for (const QString& dir : dirs) {
 
-		if (!fh.open(QIODevice::WriteOnly | QIODevice::Append)) {
-			qWarning() << "could not save log to" << logPath;
-			return;
+			QVector<PageXmlValidator> validators = PageXmlValidator::validateDirectory(dir);
+
+			for (const PageXmlValidator& v : validators) {
+
+				QSharedPointer<PageXmlInfo> xmlInfo(new PageXmlInfo(batchInfo.first()->id(), v.imagePath()));
+				xmlInfo->setStatus(v.status());
+				infos << xmlInfo;
+			}
 		}
 
-		qInfo() << "validator report -----------------------------------------------";
-		QTextStream fs(&fh);
+		writeValidatorLog(infos);
+		qInfo() << infos.size() << "PAGE XMLs in" << dirs.size() << "folders validated in" << dt;
+	}
+}
+
+void PageXmlPlugin::writeValidatorLog(const QVector<QSharedPointer<nmc::DkBatchInfo> >& batchInfo) const {
 
-		int errCnt = 0;
+	QString logPath(mConfig.validatorLog());
 
-		for (auto bi : batchInfo) {
+	// create default log path
+	if (logPath.isEmpty()) {
+		QString td = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
+		QString ts = QDateTime::currentDateTime().toString("yyyy-MM-dd HH-mm-ss");
+		QString fn = tr("xml-validator-log-") + ts + ".txt";
+		logPath = QFileInfo(td, fn).absoluteFilePath();
+	}
+
+	QFile fh(logPath);
+
+	if (!fh.open(QIODevice::WriteOnly | QIODevice::Append)) {
+		qWarning() << "could not save log to" << logPath;
+		return;
+	}
 
-			auto li = qSharedPointerDynamicCast<PageXmlInfo>(bi);
+	qInfo() << "validator report -----------------------------------------------";
+	QTextStream fs(&fh);
 
-			if (li) {
-				QString s = li->status();
-				QString sy = li->filePath() + "\t- " + s;
+	int errCnt = 0;
 
-				if (!s.isEmpty()) {
-					fs << sy << "\n";
-					errCnt++;
-				}
+	for (auto bi : batchInfo) {
 
-				qInfo() << sy;
+		auto li = qSharedPointerDynamicCast<PageXmlInfo>(bi);
+
+		if (li) {
+			QString s = li->status();
+			QString sy = li->filePath() + "\t- " + s;
+
+			if (!s.isEmpty()) {
+				fs << sy << "\n";
+				errCnt++;
 			}
+
+			qInfo() << sy;
 		}
+	}
 
-		fs << errCnt << "/" << batchInfo.size() << "errored\n";
+	fs << errCnt << "/" << batchInfo.size() << "errored\n";
 
 
-		qInfo() << "validator report written to" << logPath;
-	}
+	qInfo() << "validator report written to" << logPath;
 }
 
 QString PageXmlPlugin::settingsFilePath() const {
@@ -217,8 +266,151 @@ QSharedPointer<nmc::DkImageContainer> PageXmlPlugin::runPlugin(
 	if (!imgC)
 		return imgC;
 
-	// load suplemental XML
+	// the validators do not need the full PAGE tree
+	if (runID == mRunIDs[id_page_validator]) {
+
+		QSharedPointer<PageXmlInfo> xmlInfo(new PageXmlInfo(runID, imgC->filePath()));
+
+		PageXmlValidator v(saveInfo.inputFilePath());
+		v.setImageSize(imgC->image().size());	// the batch decoded the image already
+
+		if (!v.validate())
+			imgC->clear();	// indicate the error
+		
+		xmlInfo->setStatus(v.status());
+		batchInfo = xmlInfo;
+
+		return imgC;
+	}
+	else if (runID == mRunIDs[id_page_validator_dir]) {
+
+		// the folders are validated once in postLoadPlugin
+		batchInfo = QSharedPointer<PageXmlInfo>(new PageXmlInfo(runID, imgC->filePath()));
+
+		return imgC;
+	}
+
 	QString loadXmlPath = rdf::PageXmlParser::imagePathToXmlPath(saveInfo.inputFilePath());
+
+	// these run IDs have their own loaders - so the full PAGE tree is not built twice
+	if (runID == mRunIDs[id_page_filter]) {
+
+		QString saveXmlPath = rdf::PageXmlParser::imagePathToXmlPath(saveInfo.outputFilePath());
+		
+		if (filterRegions(loadXmlPath, saveXmlPath, imgC))
+			return imgC;
+
+		// fall back to the PAGE parser (e.g. if there is no XML yet)
+	}
+	else if (runID == mRunIDs[id_page_to_gt]) {
+
+		QSharedPointer<PageXmlInfo> xmlInfo(new PageXmlInfo(runID, imgC->filePath()));
+
+		// test loading of label lookup
+		rdf::LabelManager lm = rdf::LabelManager::read(mConfig.labelConfigPath());
+		qInfo().noquote() << lm.toString();
+
+		rdf::Timer dt;
+		bool indexed = !mConfig.labelMapFormat().isEmpty();
+		PageLabelMap labelMap(indexed ? imgC->image().size() : QSize(), rdf::LabelInfo::label_background);
+
+		QSharedPointer<rdf::RootRegion> root(new rdf::RootRegion());
+		QVector<QSharedPointer<rdf::Region> > parents;
+
+		// stream the XML - labels are mapped by rdf (like the SuperPixelLabeler does) using lightweight regions
+		PageXmlStreamReader reader(loadXmlPath);
+		bool ok = QFileInfo(loadXmlPath).exists() && reader.read([&](const PageXmlRegion& pr) {
+
+			auto r = createRegion(pr);
+
+			// write the label ids directly (8/16 bit) - in document order (parents before children)
+			if (indexed) {
+				int label = lm.find(*r).id();
+
+				if (label != rdf::LabelInfo::label_unknown)
+					labelMap.addRegion(pr.polygon, label);
+			}
+			else
+				addToTree(root, parents, r, pr.depth);
+		});
+
+		if (ok) {
+
+			if (indexed) {
+
+				cv::Mat lMap = labelMap.render();
+
+				QString lPath = rdf::Utils::createFilePath(saveInfo.outputFilePath(), "-labels", mConfig.labelMapFormat());
+				if (!labelMap.write(lPath, lMap))
+					qWarning() << "could not write" << lPath;
+
+				imgC->setImage(nmc::DkImage::mat2QImage(PageLabelMap::toVisualization(lMap)), tr("Label Map"));
+			}
+			else {
+				rdf::SuperPixelLabeler spl;
+				spl.setLabelManager(lm);
+				spl.setRootRegion(root);
+
+				QImage lImg = spl.createLabelImage(imgC->image().rect(), false);
+				imgC->setImage(lImg, tr("Label Image"));
+			}
+
+			qDebug() << "labels rendered in" << dt;
+
+			// if everything is fine - check if the dimensions are there...
+			if (reader.imageSize() != imgC->image().size()) {
+				xmlInfo->setStatus("ERROR page exists, but image size is wrong");
+				imgC->clear();	// indicate the error
+			}
+			// uncomment if you want to find all 'ok'
+			//else
+			//	xmlInfo->setStatus("OK");
+		}
+		else {
+
+			xmlInfo->setStatus(QFileInfo(loadXmlPath).exists() ? 
+				"ERROR could not parse PAGE XML: " + reader.errorString() : 
+				"ERROR PAGE XML does not exist");
+			imgC->clear();	// indicate the error
+		}
+
+		batchInfo = xmlInfo;
+		return imgC;
+	}
+	else if (runID == mRunIDs[id_page_drawer]) {
+
+		QSharedPointer<rdf::RootRegion> root;
+
+		if (mConfig.useCache()) {
+			root = readRegions(loadXmlPath);
+		}
+		else {
+			rdf::PageXmlParser parser;
+			parser.read(loadXmlPath);
+
+			if (parser.page() && !parser.page()->isEmpty())
+				root = parser.page()->rootRegion();
+		}
+
+		QImage img = drawRegions(imgC->image(), root);
+		imgC->setImage(img, tr("PAGE Attributes"));
+
+		// write the overlay directly (e.g. for QA of large batches)
+		if (!mConfig.drawFormat().isEmpty()) {
+
+			QString drawPath = rdf::Utils::createFilePath(saveInfo.outputFilePath(), "-page", mConfig.drawFormat());
+			QImageWriter writer(drawPath);
+			writer.setQuality(mConfig.drawQuality());
+			writer.setCompression(mConfig.drawCompression());
+
+			if (!writer.write(img))
+				qWarning() << "could not write" << drawPath << "-" << writer.errorString();
+		}
+
+		return imgC;
+	}
+
+	// load suplemental XML
 	rdf::PageXmlParser parser;
 	parser.read(loadXmlPath);
 
@@ -238,91 +430,241 @@ QSharedPointer<nmc::DkImageContainer> PageXmlPlugin::runPlugin(
 		QString saveXmlPath = rdf::PageXmlParser::imagePathToXmlPath(saveInfo.outputFilePath());
 		parser.write(saveXmlPath, parser.page());
 	}
-	else if (runID == mRunIDs[id_page_drawer]) {
+	else if (runID == mRunIDs[id_page_pipeline]) {
 
-		QImage img = imgC->image();
-		img = img.convertToFormat(QImage::Format_RGBA8888);
+		rdf::Timer dt;
+		auto xmlPage = parser.page();
 
-		QPainter painter(&img);
-		painter.setRenderHints(QPainter::Antialiasing);
+		if (!xmlPage) {
+			qWarning() << "could not load" << loadXmlPath;
+			return imgC;
+		}
 
-		const auto pd = parser.page();
-		if (parser.page() && !parser.page()->isEmpty())
-			rdf::RegionManager::instance().drawRegion(painter, parser.page()->rootRegion(), mConfig.xmlConfig());
+		xmlPage->setCreator(QString("CVL"));
+		QHash<QString, QString> ids = runPipeline(xmlPage, imgC);
 
-		imgC->setImage(img, tr("PAGE Attributes"));
+		// save xml - references (e.g. ReadingOrder) to renamed or dropped regions are updated while writing
+		QString saveXmlPath = rdf::PageXmlParser::imagePathToXmlPath(saveInfo.outputFilePath());
+		PageXmlRefUpdater refUpdater(ids);
+		
+		if (!refUpdater.write(parser.writePageElement(xmlPage), saveXmlPath))
+			qWarning() << "could not write" << saveXmlPath << "-" << refUpdater.errorString();
+
+		qDebug() << "PAGE pipeline" << mConfig.pipeline() << "applied in" << dt;
 	}
-	else if (runID == mRunIDs[id_page_validator]) {
 
-		QSharedPointer<PageXmlInfo> xmlInfo(new PageXmlInfo(runID, imgC->filePath()));
-		
-		// if everything is fine - check if the dimensions are there...
-		if (parser.loadStatus() == rdf::PageXmlParser::status_ok) {
+	// wrong runID? - do nothing
+	return imgC;
+}
 
-			if (parser.page()->imageSize() != imgC->image().size()) {
-				xmlInfo->setStatus("ERROR page exists, but image size is wrong");
-				imgC->clear();	// indicate the error
-			}
-			// uncomment if you want to find all 'ok'
-			//else
-			//	xmlInfo->setStatus("OK");
-		}
-		// fix empty plugins
-		else if (parser.loadStatus() == rdf::PageXmlParser::status_file_empty) {
+/// <summary>
+/// Streams the XML and keeps only regions of the type specified in filterName.
+/// </summary>
+/// <returns>false if the XML cannot be streamed (e.g. it does not exist yet).</returns>
+bool PageXmlPlugin::filterRegions(const QString & xmlPath, const QString & saveXmlPath, QSharedPointer<nmc::DkImageContainer> imgC) const {
 
-			// set minimally required values
-			parser.page()->setImageFileName(imgC->fileName());
-			parser.page()->setImageSize(imgC->image().size());
+	QFileInfo xmlInfo(xmlPath);
+	if (!xmlInfo.exists() || xmlInfo.size() == 0)
+		return false;
 
-			// save xml
-			parser.write(loadXmlPath, parser.page());
-			xmlInfo->setStatus("XML fixed");
-		}
-		else {
+	QString fn = mConfig.filterName();
+	QStringList keepTypes;
 
-			xmlInfo->setStatus(parser.loadStatusMessage());
-			imgC->clear();	// indicate the error
+	// 'Page' removes all elements
+	if (fn != "Page") {
+
+		if (!rdf::RegionManager::instance().isValidTypeName(fn))
+			return false;
+
+		keepTypes << fn;
+	}
+
+	// set our header info
+	PageXmlStreamFilter filter(keepTypes);
+	filter.setCreator(QString("CVL"));
+	filter.setImageInfo(imgC->fileName(), imgC->image().size());
+
+	if (!filter.filter(xmlPath, saveXmlPath)) {
+		qWarning() << "could not filter" << xmlPath << "-" << filter.errorString();
+		return false;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Draws all regions of root onto img.
+/// The image is split into horizontal bands which are drawn concurrently.
+/// Each band only draws regions whose bounding box (padded by the widest pen)
+/// intersects it. Text is drawn in a final pass on the full image since its
+/// extent does not depend on the region's polygon.
+/// </summary>
+/// <param name="img">The image.</param>
+/// <param name="root">The root region.</param>
+/// <returns>The image with all regions drawn.</returns>
+QImage PageXmlPlugin::drawRegions(const QImage & img, QSharedPointer<rdf::RootRegion> root) const {
+
+	rdf::Timer dt;
+
+	// the raster engine is fastest with premultiplied ARGB - but it changes the output format
+	QImage dImg = img.convertToFormat(mConfig.premultipliedDraw() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGBA8888);
+
+	if (!root || dImg.isNull())
+		return dImg;
+
+	QVector<QSharedPointer<rdf::Region> > regions = root->allRegions();
+	QVector<QRectF> boxes;
+	boxes.reserve(regions.size());
+
+	// the bands draw no text - text is drawn in a final pass
+	QVector<QSharedPointer<rdf::RegionTypeConfig> > config;
+	QVector<QSharedPointer<rdf::RegionTypeConfig> > textConfig;
+	double pad = 1.0;	// antialiasing
+
+	for (auto c : mConfig.xmlConfig()) {
+
+		if (!c) {
+			config << c;
+			textConfig << c;
+			continue;
 		}
 
-		batchInfo = xmlInfo;
+		// pad the boxes since pens can exceed the polygons
+		pad = qMax(pad, c->pen().widthF() + 1.0);
+
+		QSharedPointer<rdf::RegionTypeConfig> bc(new rdf::RegionTypeConfig(*c));
+		bc->setDrawText(false);
+		config << bc;
+
+		QSharedPointer<rdf::RegionTypeConfig> tc(new rdf::RegionTypeConfig(*c));
+		tc->setDrawPoly(false);
+		tc->setDrawBaseline(false);
+		tc->setBrush(QColor(0, 0, 0, 0));
+		textConfig << tc;
 	}
-	else if (runID == mRunIDs[id_page_to_gt]) {
 
-		QSharedPointer<PageXmlInfo> xmlInfo(new PageXmlInfo(runID, imgC->filePath()));
+	for (auto r : regions) {
 
-		// if everything is fine - check if the dimensions are there...
-		if (parser.loadStatus() == rdf::PageXmlParser::status_ok) {
+		QRectF box = r->polygon().polygon().boundingRect();
 
-			// test loading of label lookup
-			rdf::LabelManager lm = rdf::LabelManager::read(mConfig.labelConfigPath());
-			qInfo().noquote() << lm.toString();
-				
-			rdf::SuperPixelLabeler spl;
-			spl.setLabelManager(lm);
-			spl.setRootRegion(parser.page()->rootRegion());
+		auto tl = r.dynamicCast<rdf::TextLine>();
+		if (tl)
+			box = box.united(tl->baseLine().polygon().polygon().boundingRect());
 
-			QImage lImg = spl.createLabelImage(imgC->image().rect(), false);
-			imgC->setImage(lImg, tr("Label Image"));
+		boxes << box.adjusted(-pad, -pad, pad, pad);
+	}
 
-			if (parser.page()->imageSize() != imgC->image().size()) {
-				xmlInfo->setStatus("ERROR page exists, but image size is wrong");
-				imgC->clear();	// indicate the error
-			}
-			// uncomment if you want to find all 'ok'
-			//else
-			//	xmlInfo->setStatus("OK");
-		}
-		else {
+	int numBands = qMax(1, QThread::idealThreadCount() * 2);
+	int bandHeight = qCeil((double)dImg.height() / numBands);
 
-			xmlInfo->setStatus(parser.loadStatusMessage());
-			imgC->clear();	// indicate the error
+	QVector<QRect> bands;
+	for (int y = 0; y < dImg.height(); y += bandHeight)
+		bands << QRect(0, y, dImg.width(), qMin(bandHeight, dImg.height() - y));
+
+	// detach once before the bands share the buffer
+	uchar* bits = dImg.bits();
+	int bpl = dImg.bytesPerLine();
+
+	QtConcurrent::blockingMap(bands, [&](const QRect& band) {
+
+		// the band is a view into the page - no copy
+		QImage bImg(bits + band.top() * bpl, band.width(), band.height(), bpl, dImg.format());
+
+		QPainter p(&bImg);
+		p.setRenderHints(QPainter::Antialiasing);
+		p.translate(0, -band.top());
+
+		for (int idx = 0; idx < regions.size(); idx++) {
+
+			if (boxes[idx].intersects(band))
+				rdf::RegionManager::instance().drawRegion(p, regions[idx], config, false);
 		}
+	});
 
-		batchInfo = xmlInfo;
+	// draw text (unbanded)
+	bool drawText = false;
+	for (auto c : mConfig.xmlConfig())
+		drawText |= c && c->draw() && c->drawText();
+
+	if (drawText) {
+
+		QPainter p(&dImg);
+		p.setRenderHints(QPainter::Antialiasing);
+
+		for (auto r : regions)
+			rdf::RegionManager::instance().drawRegion(p, r, textConfig, false);
 	}
 
-	// wrong runID? - do nothing
-	return imgC;
+	qDebug() << regions.size() << "regions drawn in" << bands.size() << "bands in" << dt;
+
+	return dImg;
+}
+
+/// <summary>
+/// Reads the region tree from the binary sidecar (or the XML if there is no valid sidecar).
+/// NOTE: the tree is not complete (e.g. text is missing) so use it for read-only tasks only.
+/// </summary>
+/// <param name="xmlPath">The PAGE XML path.</param>
+/// <returns>The root region or a null pointer if the XML could not be read.</returns>
+QSharedPointer<rdf::RootRegion> PageXmlPlugin::readRegions(const QString & xmlPath) const {
+
+	QSharedPointer<rdf::RootRegion> root(new rdf::RootRegion());
+
+	// open regions (index = depth)
+	QVector<QSharedPointer<rdf::Region> > parents;
+
+	PageXmlCache cache(xmlPath, mConfig.useCache());
+	bool ok = cache.read([&](const PageXmlRegion& pr) {
+		addToTree(root, parents, createRegion(pr), pr.depth);
+	});
+
+	if (!ok) {
+		qWarning() << "could not read" << xmlPath << "-" << cache.errorString();
+		return QSharedPointer<rdf::RootRegion>();
+	}
+
+	return root;
+}
+
+/// <summary>
+/// Creates a (lightweight) rdf region from a streamed region.
+/// Only the type, id, custom attribute, polygon and baseline are set.
+/// </summary>
+QSharedPointer<rdf::Region> PageXmlPlugin::createRegion(const PageXmlRegion & pr) {
+
+	const rdf::RegionManager& rm = rdf::RegionManager::instance();
+
+	auto r = rm.createRegion(rm.type(pr.type));
+	r->setId(pr.id);
+	r->setCustom(pr.custom);
+	r->setPolygon(rdf::Polygon(pr.polygon));
+
+	if (!pr.baseLine.isEmpty()) {
+		auto tl = r.dynamicCast<rdf::TextLine>();
+		if (tl)
+			tl->setBaseLine(rdf::BaseLine(rdf::Polygon(pr.baseLine)));
+	}
+
+	return r;
+}
+
+/// <summary>
+/// Adds a streamed region to the region tree.
+/// Regions must be added in document order (parents before children).
+/// </summary>
+/// <param name="root">The root region.</param>
+/// <param name="parents">The currently open regions (index = depth).</param>
+/// <param name="region">The region to add.</param>
+/// <param name="depth">The region's depth (0 for direct children of the Page element).</param>
+void PageXmlPlugin::addToTree(QSharedPointer<rdf::RootRegion>& root, QVector<QSharedPointer<rdf::Region> >& parents, const QSharedPointer<rdf::Region>& region, int depth) {
+
+	parents.resize(depth + 1);
+	parents[depth] = region;
+
+	if (depth > 0 && parents[depth-1])
+		parents[depth-1]->addChild(region);
+	else
+		root->addChild(region);
 }
 
 void PageXmlPlugin::filterRegions(QSharedPointer<rdf::PageElement> & page) const {
@@ -349,6 +691,148 @@ void PageXmlPlugin::filterRegions(QSharedPointer<rdf::PageElement> & page) const
 	root->setChildren(regions);
 }
 
+/// <summary>
+/// Applies all operations of the pipeline to the page (in the order specified).
+/// Supported operations are: filter, rescale, dropEmpty, fixImageSize, renumber.
+/// </summary>
+/// <param name="page">The page.</param>
+/// <param name="imgC">The image container.</param>
+/// <returns>The ids of renamed (old -> new) and dropped (old -> empty) regions.</returns>
+QHash<QString, QString> PageXmlPlugin::runPipeline(QSharedPointer<rdf::PageElement>& page, QSharedPointer<nmc::DkImageContainer> imgC) const {
+
+	QHash<QString, QString> ids;
+
+	for (const QString& op : mConfig.pipeline()) {
+
+		if (op == "filter") {
+
+			QStringList before;
+			for (auto r : page->rootRegion()->allRegions())
+				before << r->id();
+
+			filterRegions(page);
+
+			// remember the filtered regions
+			QSet<QString> after;
+			for (auto r : page->rootRegion()->allRegions())
+				after << r->id();
+
+			for (const QString& id : before) {
+				if (!after.contains(id))
+					ids.insert(id, QString());
+			}
+		}
+		else if (op == "rescale") {
+			rescaleRegions(page, mConfig.rescaleFactor());
+		}
+		else if (op == "dropEmpty") {
+			dropEmptyRegions(page->rootRegion(), ids);
+		}
+		else if (op == "fixImageSize") {
+			page->setImageSize(QSize(imgC->image().size()));
+			page->setImageFileName(imgC->fileName());
+		}
+		else if (op == "renumber") {
+			renumberRegions(page, ids);
+		}
+		else
+			qWarning() << "unknown PAGE operation:" << op;
+	}
+
+	return ids;
+}
+
+void PageXmlPlugin::rescaleRegions(QSharedPointer<rdf::PageElement>& page, double scaleFactor) const {
+
+	if (scaleFactor == 1.0)
+		return;
+
+	QTransform t = QTransform::fromScale(scaleFactor, scaleFactor);
+
+	for (auto r : page->rootRegion()->allRegions()) {
+
+		r->setPolygon(rdf::Polygon(t.map(r->polygon().polygon())));
+
+		auto tl = r.dynamicCast<rdf::TextLine>();
+		if (tl)
+			tl->setBaseLine(rdf::BaseLine(rdf::Polygon(t.map(tl->baseLine().polygon().polygon()))));
+	}
+
+	page->setImageSize(page->imageSize() * scaleFactor);
+}
+
+/// <summary>
+/// Removes all regions that have neither an area, a baseline, text nor children.
+/// Separators are kept since they are lines.
+/// Children are removed first, so parents which become empty are dropped too.
+/// </summary>
+/// <param name="region">The region.</param>
+/// <param name="ids">The ids of dropped regions are added (mapped to an empty id).</param>
+/// <returns>true if region is empty.</returns>
+bool PageXmlPlugin::dropEmptyRegions(QSharedPointer<rdf::Region> region, QHash<QString, QString>& ids) const {
+
+	QVector<QSharedPointer<rdf::Region> > children;
+
+	for (auto c : region->children()) {
+
+		if (!dropEmptyRegions(c, ids))
+			children << c;
+		else
+			ids.insert(c->id(), QString());
+	}
+
+	if (children.size() != region->children().size())
+		region->setChildren(children);
+
+	if (!children.empty() || region->polygon().polygon().size() >= 3)
+		return false;
+
+	if (region->type() == rdf::Region::type_separator)
+		return false;
+
+	auto tl = region.dynamicCast<rdf::TextLine>();
+	if (tl && (!tl->baseLine().polygon().polygon().isEmpty() || !tl->text().isEmpty()))
+		return false;
+
+	return true;
+}
+
+/// <summary>
+/// Renames all regions to <type>_<number> (in document order).
+/// </summary>
+/// <param name="page">The page.</param>
+/// <param name="ids">The renamed ids are added (old -> new).</param>
+void PageXmlPlugin::renumberRegions(QSharedPointer<rdf::PageElement>& page, QHash<QString, QString>& ids) const {
+
+	const rdf::RegionManager& rm = rdf::RegionManager::instance();
+	QMap<QString, int> counter;
+	QHash<QString, QString> renamed;
+
+	for (auto r : page->rootRegion()->allRegions()) {
+		
+		QString tn = rm.typeName(r->type());
+		QString id = tn + "_" + QString::number(++counter[tn]);
+
+		if (r->id() != id)
+			renamed.insert(r->id(), id);
+
+		r->setId(id);
+	}
+
+	// ids that were renamed before point to the current ids
+	for (auto it = ids.begin(); it != ids.end(); it++) {
+
+		if (!it.value().isEmpty())
+			it.value() = renamed.value(it.value(), it.value());
+	}
+
+	for (auto it = renamed.constBegin(); it != renamed.constEnd(); it++) {
+
+		if (!ids.contains(it.key()))
+			ids.insert(it.key(), it.value());
+	}
+}
+
 // configurations that are specific for the plugin --------------------------------------------------------------------
 PageXmlConfig::PageXmlConfig() : ModuleConfig("General") {
 }
@@ -357,6 +841,9 @@ QString PageXmlConfig::toString() const {
 
 	QString msg = rdf::ModuleConfig::toString();
 	msg += "filtering all regions except: " + filterName();
+	msg += useCache() ? "\n using binary PAGE sidecars" : "";
+	msg += !drawFormat().isEmpty() ? "\n writing PAGE overlays as " + drawFormat() : "";
+	msg += premultipliedDraw() ? "\n drawing premultiplied ARGB" : "";
 
 	return msg;
 }
@@ -373,6 +860,38 @@ QString PageXmlConfig::filterName() const {
 	return mFilterName;
 }
 
+QStringList PageXmlConfig::pipeline() const {
+	return mPipeline.split(",", QString::SkipEmptyParts);
+}
+
+double PageXmlConfig::rescaleFactor() const {
+	return mRescaleFactor;
+}
+
+QString PageXmlConfig::labelMapFormat() const {
+	return mLabelMapFormat;
+}
+
+QString PageXmlConfig::drawFormat() const {
+	return mDrawFormat;
+}
+
+bool PageXmlConfig::premultipliedDraw() const {
+	return mPremultipliedDraw;
+}
+
+int PageXmlConfig::drawQuality() const {
+	return mDrawQuality;
+}
+
+int PageXmlConfig::drawCompression() const {
+	return mDrawCompression;
+}
+
+bool PageXmlConfig::useCache() const {
+	return mUseCache;
+}
+
 QVector<QSharedPointer<rdf::RegionTypeConfig>> rdm::PageXmlConfig::xmlConfig() const {
 	return mXmlConfig;
 }
@@ -382,6 +901,14 @@ void PageXmlConfig::load(const QSettings & settings) {
 	mFilterName = settings.value("filterName", mFilterName).toString();
 	mValidatorLog = settings.value("validatorLogFilePath", mValidatorLog).toString();
 	mLabelConfig = settings.value("labelConfigPath", mLabelConfig).toString();
+	mUseCache = settings.value("useCache", mUseCache).toBool();
+	mDrawFormat = settings.value("drawFormat", mDrawFormat).toString();
+	mPremultipliedDraw = settings.value("premultipliedDraw", mPremultipliedDraw).toBool();
+	mLabelMapFormat = settings.value("labelMapFormat", mLabelMapFormat).toString();
+	mPipeline = settings.value("pipeline", mPipeline).toString().remove(" ");
+	mRescaleFactor = settings.value("rescaleFactor", mRescaleFactor).toDouble();
+	mDrawQuality = settings.value("drawQuality", mDrawQuality).toInt();
+	mDrawCompression = settings.value("drawCompression", mDrawCompression).toInt();
 
 	// highjack the page vis plugin
 	rdf::DefaultSettings s;
@@ -407,6 +934,14 @@ void PageXmlConfig::save(QSettings & settings) const {
 	settings.setValue("filterName", mFilterName);
 	settings.setValue("validatorLogFilePath", mValidatorLog);
 	settings.setValue("labelConfigPath", mLabelConfig);
+	settings.setValue("useCache", mUseCache);
+	settings.setValue("drawFormat", mDrawFormat);
+	settings.setValue("premultipliedDraw", mPremultipliedDraw);
+	settings.setValue("labelMapFormat", mLabelMapFormat);
+	settings.setValue("pipeline", mPipeline);
+	settings.setValue("rescaleFactor", mRescaleFactor);
+	settings.setValue("drawQuality", mDrawQuality);
+	settings.setValue("drawCompression", mDrawCompression);
 }
 
 // PageXmlInfo --------------------------------------------------------------------
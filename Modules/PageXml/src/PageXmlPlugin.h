@@ -35,6 +35,10 @@ related links:
 #include "DkPluginInterface.h"
 #include "BaseModule.h"
 
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QHash>
+#pragma warning(pop)		// no warnings from includes - end
+
 // opencv defines
 namespace cv {
 	class Mat;
@@ -43,11 +47,15 @@ namespace cv {
 namespace rdf {
 	class PageXmlParser;
 	class PageElement;
+	class RootRegion;
+	class Region;
 	class RegionTypeConfig;
 }
 
 namespace rdm {
 
+struct PageXmlRegion;
+
 class PageXmlConfig : public rdf::ModuleConfig {
 
 public:
@@ -59,6 +67,14 @@ public:
 	QString labelConfigPath() const;
 	QString validatorLog() const;
 	QString filterName() const;
+	bool useCache() const;
+	QString drawFormat() const;
+	bool premultipliedDraw() const;
+	QString labelMapFormat() const;
+	QStringList pipeline() const;
+	double rescaleFactor() const;
+	int drawQuality() const;
+	int drawCompression() const;
 	QVector<QSharedPointer<rdf::RegionTypeConfig> > xmlConfig() const;
 
 protected:
@@ -66,6 +82,14 @@ protected:
 	QString mLabelConfig;					// filepath to label config json
 	QString mValidatorLog;					// filepath to the XML validator log file
 	QString mFilterName = "TextRegion";
+	bool mUseCache = false;					// if true, binary sidecars are used for read-only tasks
+	QString mDrawFormat;					// if set (e.g. jpg), the PAGE drawer additionally writes its overlay to <name>-page.<format> (off by default)
+	bool mPremultipliedDraw = false;		// if true, the PAGE drawer returns ARGB32_Premultiplied (faster) instead of RGBA8888
+	int mDrawQuality = -1;					// QImageWriter quality (-1 = default)
+	int mDrawCompression = 0;				// QImageWriter compression (e.g. png/tif)
+	QString mPipeline = "dropEmpty,fixImageSize";	// comma separated: filter, rescale, dropEmpty, fixImageSize, renumber
+	double mRescaleFactor = 1.0;			// used by the rescale operation
+	QString mLabelMapFormat;				// if set (png or npy), indexed label maps are written instead of color label images
 	QVector<QSharedPointer<rdf::RegionTypeConfig> > mXmlConfig;
 
 	void load(const QSettings& settings) override;
@@ -118,6 +142,8 @@ public:
 		id_page_drawer,
 		id_page_validator,
 		id_page_to_gt,
+		id_page_validator_dir,
+		id_page_pipeline,
 		// add actions here
 
 		id_end
@@ -133,5 +159,15 @@ protected:
 
 	// layout plugin functions
 	void filterRegions(QSharedPointer<rdf::PageElement> & page) const;
+	bool filterRegions(const QString& xmlPath, const QString& saveXmlPath, QSharedPointer<nmc::DkImageContainer> imgC) const;
+	QHash<QString, QString> runPipeline(QSharedPointer<rdf::PageElement>& page, QSharedPointer<nmc::DkImageContainer> imgC) const;
+	void rescaleRegions(QSharedPointer<rdf::PageElement>& page, double scaleFactor) const;
+	bool dropEmptyRegions(QSharedPointer<rdf::Region> region, QHash<QString, QString>& ids) const;
+	void renumberRegions(QSharedPointer<rdf::PageElement>& page, QHash<QString, QString>& ids) const;
+	QImage drawRegions(const QImage& img, QSharedPointer<rdf::RootRegion> root) const;
+	QSharedPointer<rdf::RootRegion> readRegions(const QString& xmlPath) const;
+	static QSharedPointer<rdf::Region> createRegion(const PageXmlRegion& pr);
+	static void addToTree(QSharedPointer<rdf::RootRegion>& root, QVector<QSharedPointer<rdf::Region> >& parents, const QSharedPointer<rdf::Region>& region, int depth);
+	void writeValidatorLog(const QVector<QSharedPointer<nmc::DkBatchInfo> >& batchInfo) const;
 };
 };
@@ -0,0 +1,550 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#include "PageXmlStream.h"
+
+// ReadFramework
+#include "ElementsHelper.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+// PageXmlStreamReader --------------------------------------------------------------------
+PageXmlStreamReader::PageXmlStreamReader(const QString& xmlPath) {
+	mXmlPath = xmlPath;
+}
+
+/// <summary>
+/// Streams the XML and calls visitor for every region.
+/// A region is visited as soon as its Coords and Baseline
+/// are known (i.e. before its children are visited).
+/// </summary>
+/// <param name="visitor">The visitor.</param>
+/// <returns>true if the XML was parsed successfully.</returns>
+bool PageXmlStreamReader::read(std::function<void(const PageXmlRegion&)> visitor) {
+
+	QFile f(mXmlPath);
+
+	if (!f.open(QIODevice::ReadOnly)) {
+		mError = "could not open " + mXmlPath;
+		return false;
+	}
+
+	QXmlStreamReader reader(&f);
+
+	QVector<PageXmlRegion> regions;		// currently open regions
+	QVector<int> regionDepth;			// element depth of the open regions
+	QVector<bool> visited;
+	QPolygonF* points = 0;				// the polygon we currently parse (old PAGE format)
+	int depth = 0;
+
+	auto visitOpen = [&]() {
+		if (!regions.empty() && !visited.last()) {
+			visitor(regions.last());
+			visited.last() = true;
+		}
+	};
+
+	while (!reader.atEnd()) {
+
+		reader.readNext();
+
+		if (reader.isStartElement()) {
+
+			QString name = reader.name().toString();
+			depth++;
+
+			if (name == "Page") {
+				QXmlStreamAttributes attr = reader.attributes();
+				mImageFileName = attr.value("imageFilename").toString();
+				mImageSize = QSize(attr.value("imageWidth").toInt(), attr.value("imageHeight").toInt());
+			}
+			else if (isRegion(name)) {
+
+				// visit the parent before its children
+				visitOpen();
+
+				PageXmlRegion r;
+				r.type = name;
+				r.id = reader.attributes().value("id").toString();
+				r.custom = reader.attributes().value("custom").toString();
+				r.depth = regions.size();
+
+				regions << r;
+				regionDepth << depth;
+				visited << false;
+			}
+			else if (!regions.empty() && depth == regionDepth.last() + 1 && (name == "Coords" || name == "Baseline")) {
+
+				points = (name == "Coords") ? &regions.last().polygon : &regions.last().baseLine;
+
+				// PAGE 2013 stores the points as attribute
+				QStringRef pts = reader.attributes().value("points");
+				if (!pts.isEmpty())
+					*points = parsePoints(pts.toString());
+			}
+			else if (points && name == "Point") {
+				QXmlStreamAttributes attr = reader.attributes();
+				*points << QPointF(attr.value("x").toDouble(), attr.value("y").toDouble());
+			}
+		}
+		else if (reader.isEndElement()) {
+
+			QString name = reader.name().toString();
+
+			if (name == "Coords" || name == "Baseline")
+				points = 0;
+			else if (!regions.empty() && depth == regionDepth.last()) {
+				visitOpen();
+				regions.pop_back();
+				regionDepth.pop_back();
+				visited.pop_back();
+			}
+
+			depth--;
+		}
+	}
+
+	if (reader.hasError()) {
+		mError = reader.errorString();
+		return false;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Returns all regions of the specified types.
+/// </summary>
+/// <param name="types">The element names (e.g. TextRegion).</param>
+QVector<PageXmlRegion> PageXmlStreamReader::regions(const QStringList & types) {
+
+	QVector<PageXmlRegion> regions;
+
+	read([&](const PageXmlRegion& r) {
+		if (types.contains(r.type))
+			regions << r;
+	});
+
+	return regions;
+}
+
+QString PageXmlStreamReader::xmlPath() const {
+	return mXmlPath;
+}
+
+QString PageXmlStreamReader::imageFileName() const {
+	return mImageFileName;
+}
+
+/// <summary>
+/// Returns the image size of the Page element.
+/// It is valid once read() was called.
+/// </summary>
+QSize PageXmlStreamReader::imageSize() const {
+	return mImageSize;
+}
+
+QString PageXmlStreamReader::errorString() const {
+	return mError;
+}
+
+bool PageXmlStreamReader::isRegion(const QString & elementName) {
+
+	// the Page is our root
+	if (elementName == "Page")
+		return false;
+
+	return rdf::RegionManager::instance().isValidTypeName(elementName);
+}
+
+QPolygonF PageXmlStreamReader::parsePoints(const QString & points) {
+
+	QPolygonF poly;
+
+	for (const QString& p : points.split(" ", QString::SkipEmptyParts)) {
+
+		int idx = p.indexOf(",");
+		if (idx == -1)
+			continue;
+
+		poly << QPointF(p.left(idx).toDouble(), p.mid(idx+1).toDouble());
+	}
+
+	return poly;
+}
+
+// PageXmlStreamFilter --------------------------------------------------------------------
+PageXmlStreamFilter::PageXmlStreamFilter(const QStringList& keepTypes) {
+	mKeepTypes = keepTypes;
+}
+
+void PageXmlStreamFilter::setImageInfo(const QString & fileName, const QSize & size) {
+	mImageFileName = fileName;
+	mImageSize = size;
+}
+
+void PageXmlStreamFilter::setCreator(const QString & creator) {
+	mCreator = creator;
+}
+
+/// <summary>
+/// Filters the PAGE XML inPath and writes the result to outPath.
+/// inPath and outPath can be the same file.
+/// </summary>
+/// <returns>true on success.</returns>
+bool PageXmlStreamFilter::filter(const QString & inPath, const QString & outPath) {
+
+	QFile in(inPath);
+
+	if (!in.open(QIODevice::ReadOnly)) {
+		mError = "could not open " + inPath;
+		return false;
+	}
+
+	// NOTE: QSaveFile writes to a temporary file first
+	QSaveFile out(outPath);
+
+	if (!out.open(QIODevice::WriteOnly)) {
+		mError = "could not write to " + outPath;
+		return false;
+	}
+
+	QXmlStreamReader reader(&in);
+	QXmlStreamWriter writer(&out);
+	writer.setAutoFormatting(true);
+
+	QVector<bool> written;		// true if the open element was written
+	int keptDepth = -1;			// depth of the region (or Page child) that is currently kept
+	int pageDepth = -1;			// depth of the Page element
+	bool inPage = false;
+	bool replaceText = false;
+
+	while (!reader.atEnd()) {
+
+		reader.readNext();
+
+		switch (reader.tokenType()) {
+
+		case QXmlStreamReader::StartDocument:
+			writer.writeStartDocument();
+			break;
+		case QXmlStreamReader::EndDocument:
+			writer.writeEndDocument();
+			break;
+		case QXmlStreamReader::StartElement: {
+
+			QString name = reader.name().toString();
+			bool write = true;
+
+			// drop all Page regions that are not kept
+			if (inPage && keptDepth == -1) {
+
+				if (mKeepTypes.contains(name))
+					keptDepth = written.size();
+				// keep Page children that are no regions (e.g. ReadingOrder) as they are
+				else if (written.size() == pageDepth + 1 && isPageMetaData(name))
+					keptDepth = written.size();
+				// descendants of dropped regions are still scanned for kept regions
+				else
+					write = false;
+			}
+
+			if (write) {
+
+				writer.writeStartElement(reader.qualifiedName().toString());
+
+				for (const QXmlStreamNamespaceDeclaration& ns : reader.namespaceDeclarations()) {
+					QString prefix = ns.prefix().isEmpty() ? "xmlns" : "xmlns:" + ns.prefix().toString();
+					writer.writeAttribute(prefix, ns.namespaceUri().toString());
+				}
+
+				for (const QXmlStreamAttribute& a : reader.attributes()) {
+
+					QString an = a.qualifiedName().toString();
+					QString av = a.value().toString();
+
+					// update our header info
+					if (name == "Page" && !mImageFileName.isEmpty() && an == "imageFilename")
+						av = mImageFileName;
+					else if (name == "Page" && mImageSize.isValid() && an == "imageWidth")
+						av = QString::number(mImageSize.width());
+					else if (name == "Page" && mImageSize.isValid() && an == "imageHeight")
+						av = QString::number(mImageSize.height());
+
+					writer.writeAttribute(an, av);
+				}
+
+				if (!mCreator.isEmpty() && !inPage && (name == "Creator" || name == "LastChange")) {
+					writer.writeCharacters(name == "Creator" ? mCreator : QDateTime::currentDateTime().toString(Qt::ISODate));
+					replaceText = true;
+				}
+			}
+
+			if (name == "Page") {
+				inPage = true;
+				pageDepth = written.size();
+			}
+
+			written << write;
+			break;
+		}
+		case QXmlStreamReader::EndElement: {
+
+			if (written.takeLast())
+				writer.writeEndElement();
+
+			if (keptDepth == written.size())
+				keptDepth = -1;
+
+			if (reader.name() == "Page")
+				inPage = false;
+
+			replaceText = false;
+			break;
+		}
+		case QXmlStreamReader::Characters:
+
+			if (!written.empty() && written.last() && !replaceText && !reader.isWhitespace())
+				writer.writeCharacters(reader.text().toString());
+			break;
+		case QXmlStreamReader::Comment:
+
+			if (written.empty() || written.last())
+				writer.writeComment(reader.text().toString());
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (reader.hasError()) {
+		mError = reader.errorString();
+		out.cancelWriting();
+		return false;
+	}
+
+	return out.commit();
+}
+
+QString PageXmlStreamFilter::errorString() const {
+	return mError;
+}
+
+/// <summary>
+/// Returns true if elementName is a Page child that is no region (PAGE 2013 & 2017 schema).
+/// NOTE: unknown elements are treated as regions, so they are dropped by the filter.
+/// </summary>
+bool PageXmlStreamFilter::isPageMetaData(const QString & elementName) {
+
+	static const QStringList metaData = QStringList()
+		<< "AlternativeImage"
+		<< "Border"
+		<< "PrintSpace"
+		<< "ReadingOrder"
+		<< "Layers"
+		<< "Relations"
+		<< "TextStyle"
+		<< "UserDefined"
+		<< "Labels";
+
+	return metaData.contains(elementName);
+}
+
+// PageXmlRefUpdater --------------------------------------------------------------------
+PageXmlRefUpdater::PageXmlRefUpdater(const QHash<QString, QString>& ids) {
+	mIds = ids;
+}
+
+/// <summary>
+/// Writes xml to xmlPath and updates all references.
+/// The file is written atomically.
+/// </summary>
+/// <param name="xml">The serialized PAGE XML.</param>
+/// <param name="xmlPath">The output path.</param>
+/// <returns>true on success.</returns>
+bool PageXmlRefUpdater::write(const QByteArray & xml, const QString & xmlPath) {
+
+	QSaveFile out(xmlPath);
+
+	if (xml.isEmpty() || !out.open(QIODevice::WriteOnly)) {
+		mError = "could not write to " + xmlPath;
+		return false;
+	}
+
+	// nothing to update
+	if (mIds.empty()) {
+
+		if (out.write(xml) != xml.size()) {
+			mError = "could not write to " + xmlPath;
+			out.cancelWriting();
+			return false;
+		}
+
+		return out.commit();
+	}
+
+	// indices of removed indexed references per parent element
+	QHash<int, QVector<int> > removed = removedIndices(xml);
+
+	QXmlStreamReader reader(xml);
+	QXmlStreamWriter writer(&out);
+	writer.setAutoFormatting(true);
+
+	QVector<int> parents;	// element numbers of the open elements
+	int elIdx = 0;			// element number (in document order)
+	int skipDepth = 0;		// > 0 while we are in a removed element
+
+	while (!reader.atEnd()) {
+
+		reader.readNext();
+
+		if (reader.isStartElement()) {
+
+			int parent = parents.empty() ? -1 : parents.last();
+			parents << elIdx++;
+
+			if (skipDepth > 0 || (isRemoved(reader) && reader.name().startsWith("RegionRef"))) {
+				skipDepth++;
+				continue;
+			}
+
+			writer.writeStartElement(reader.qualifiedName().toString());
+
+			for (const QXmlStreamNamespaceDeclaration& ns : reader.namespaceDeclarations()) {
+				QString prefix = ns.prefix().isEmpty() ? "xmlns" : "xmlns:" + ns.prefix().toString();
+				writer.writeAttribute(prefix, ns.namespaceUri().toString());
+			}
+
+			for (const QXmlStreamAttribute& a : reader.attributes()) {
+
+				QString an = a.qualifiedName().toString();
+				QString av = a.value().toString();
+
+				if (an == "regionRef" && mIds.contains(av)) {
+					
+					av = mIds.value(av);
+
+					// groups keep their children - they just lose the reference
+					if (av.isEmpty())
+						continue;
+				}
+				else if (an == "index" && removed.contains(parent)) {
+
+					// close the gaps of removed siblings
+					int idx = av.toInt();
+					int numRemoved = 0;
+					for (int ri : removed.value(parent))
+						numRemoved += ri < idx ? 1 : 0;
+
+					av = QString::number(idx - numRemoved);
+				}
+
+				writer.writeAttribute(an, av);
+			}
+		}
+		else if (reader.isEndElement()) {
+
+			parents.pop_back();
+
+			if (skipDepth > 0)
+				skipDepth--;
+			else
+				writer.writeCurrentToken(reader);
+		}
+		else if (skipDepth == 0 && !reader.isWhitespace())
+			writer.writeCurrentToken(reader);
+	}
+
+	if (reader.hasError()) {
+		mError = reader.errorString();
+		out.cancelWriting();
+		return false;
+	}
+
+	return out.commit();
+}
+
+/// <summary>
+/// Returns true if the current element references a removed region.
+/// </summary>
+bool PageXmlRefUpdater::isRemoved(const QXmlStreamReader & reader) const {
+
+	QString ref = reader.attributes().value("regionRef").toString();
+	return !ref.isEmpty() && mIds.contains(ref) && mIds.value(ref).isEmpty();
+}
+
+/// <summary>
+/// Returns the index attributes of removed references.
+/// The key is the element number (in document order) of their parent.
+/// </summary>
+QHash<int, QVector<int> > PageXmlRefUpdater::removedIndices(const QByteArray & xml) const {
+
+	QHash<int, QVector<int> > removed;
+
+	QXmlStreamReader reader(xml);
+	QVector<int> parents;
+	int elIdx = 0;
+
+	while (!reader.atEnd()) {
+
+		reader.readNext();
+
+		if (reader.isStartElement()) {
+
+			QStringRef idx = reader.attributes().value("index");
+
+			if (!parents.empty() && !idx.isEmpty() && isRemoved(reader) && reader.name().startsWith("RegionRef"))
+				removed[parents.last()] << idx.toInt();
+
+			parents << elIdx++;
+		}
+		else if (reader.isEndElement())
+			parents.pop_back();
+	}
+
+	return removed;
+}
+
+QString PageXmlRefUpdater::errorString() const {
+	return mError;
+}
+
+}
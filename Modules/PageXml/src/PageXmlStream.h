@@ -0,0 +1,143 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QString>
+#include <QStringList>
+#include <QPolygonF>
+#include <QSize>
+#include <QVector>
+#include <QHash>
+#include <functional>
+#pragma warning(pop)		// no warnings from includes - end
+
+class QXmlStreamReader;
+
+namespace rdm {
+
+/// <summary>
+/// A PAGE region as it is visited by the PageXmlStreamReader.
+/// </summary>
+struct PageXmlRegion {
+	QString type;			// the element name (e.g. TextRegion)
+	QString id;
+	QPolygonF polygon;		// Coords
+	QPolygonF baseLine;		// Baseline (TextLines only)
+	QString custom;			// the custom attribute (e.g. Transkribus structure types)
+	int depth = 0;			// 0 for direct children of the Page element
+};
+
+/// <summary>
+/// Streaming (SAX-style) reader for PAGE XMLs.
+/// Regions are visited in document order (parents before children)
+/// without building the region tree.
+/// </summary>
+class PageXmlStreamReader {
+
+public:
+	PageXmlStreamReader(const QString& xmlPath = QString());
+
+	bool read(std::function<void(const PageXmlRegion&)> visitor);
+	QVector<PageXmlRegion> regions(const QStringList& types);
+
+	QString xmlPath() const;
+	QString imageFileName() const;
+	QSize imageSize() const;
+	QString errorString() const;
+
+	static bool isRegion(const QString& elementName);
+
+private:
+	QString mXmlPath;
+	QString mImageFileName;
+	QSize mImageSize;
+	QString mError;
+
+	static QPolygonF parsePoints(const QString& points);
+};
+
+/// <summary>
+/// Copies a PAGE XML and keeps only regions of the specified types.
+/// Kept regions (and their children) are moved to the Page element,
+/// all other Page children are dropped - except for the non-region
+/// elements of the PAGE schema (e.g. ReadingOrder) which are copied
+/// unchanged. The document is streamed, so the region tree is never
+/// held in memory.
+/// </summary>
+class PageXmlStreamFilter {
+
+public:
+	PageXmlStreamFilter(const QStringList& keepTypes = QStringList());
+
+	void setImageInfo(const QString& fileName, const QSize& size);
+	void setCreator(const QString& creator);
+
+	bool filter(const QString& inPath, const QString& outPath);
+	QString errorString() const;
+
+	static bool isPageMetaData(const QString& elementName);
+
+private:
+	QStringList mKeepTypes;
+	QString mImageFileName;
+	QSize mImageSize;
+	QString mCreator;
+	QString mError;
+};
+
+/// <summary>
+/// Writes a serialized PAGE XML and updates its region references
+/// (regionRef attributes, e.g. in the ReadingOrder) on the fly after
+/// regions were renamed or removed (i.e. mapped to an empty id).
+/// References to removed regions are dropped: RegionRef leaves are
+/// removed, groups only lose their regionRef attribute (their children
+/// are kept). The index of the remaining indexed siblings is updated.
+/// </summary>
+class PageXmlRefUpdater {
+
+public:
+	PageXmlRefUpdater(const QHash<QString, QString>& ids = QHash<QString, QString>());
+
+	bool write(const QByteArray& xml, const QString& xmlPath);
+	QString errorString() const;
+
+private:
+	QHash<QString, QString> mIds;	// old id -> new id
+	QString mError;
+
+	bool isRemoved(const QXmlStreamReader& reader) const;
+	QHash<int, QVector<int> > removedIndices(const QByteArray& xml) const;
+};
+
+};
@@ -0,0 +1,255 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#include "PageXmlValidator.h"
+
+// ReadFramework
+#include "PageParser.h"
+#include "Elements.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QXmlStreamReader>
+#include <QtConcurrentMap>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+// PageXmlValidator --------------------------------------------------------------------
+PageXmlValidator::PageXmlValidator(const QString& imgPath) {
+	mImgPath = imgPath;
+}
+
+/// <summary>
+/// Checks if the image has a PAGE XML with the correct dimensions.
+/// Empty XMLs are fixed.
+/// </summary>
+/// <returns>true if the XML is valid (or was fixed).</returns>
+bool PageXmlValidator::validate() {
+
+	// read the header if the image was not decoded already
+	if (mImageSize.isEmpty())
+		mImageSize = readImageSize(mImgPath);
+
+	if (mImageSize.isEmpty()) {
+		mStatus = "ERROR could not read image size";
+		return false;
+	}
+
+	QFileInfo xmlInfo(xmlPath());
+
+	if (!xmlInfo.exists()) {
+		mStatus = "ERROR PAGE XML does not exist";
+		return false;
+	}
+
+	QString error;
+
+	// no Page element - let the PAGE parser decide if we can fix it
+	if (xmlInfo.size() == 0 || !readPageSize(xmlPath(), mPageSize, &error))
+		return fixEmptyXml();
+
+	if (!error.isEmpty()) {
+		mStatus = "ERROR PAGE XML is not well-formed: " + error;
+		return false;
+	}
+
+	if (mPageSize != mImageSize) {
+		mStatus = "ERROR page exists, but image size is wrong";
+		return false;
+	}
+
+	return true;
+}
+
+QString PageXmlValidator::imagePath() const {
+	return mImgPath;
+}
+
+QString PageXmlValidator::xmlPath() const {
+	return rdf::PageXmlParser::imagePathToXmlPath(mImgPath);
+}
+
+/// <summary>
+/// Returns the validation status.
+/// The status is empty if the XML is valid.
+/// </summary>
+QString PageXmlValidator::status() const {
+	return mStatus;
+}
+
+/// <summary>
+/// Sets the image size if the image is decoded already.
+/// Then, validate() does not read the image header.
+/// </summary>
+void PageXmlValidator::setImageSize(const QSize & size) {
+	mImageSize = size;
+}
+
+QSize PageXmlValidator::imageSize() const {
+	return mImageSize;
+}
+
+QSize PageXmlValidator::pageSize() const {
+	return mPageSize;
+}
+
+/// <summary>
+/// Reads the image size from the file header.
+/// The image is only decoded if its format does not
+/// report the size without decoding.
+/// </summary>
+/// <param name="imgPath">The image path.</param>
+/// <returns>The image size (with EXIF orientation applied).</returns>
+QSize PageXmlValidator::readImageSize(const QString & imgPath) {
+
+	QImageReader reader(imgPath);
+	QSize s = reader.size();
+
+	// fallback: decode the image
+	if (!s.isValid()) {
+		QImage img = reader.read();
+		return img.size();
+	}
+
+	// nomacs rotates images according to their EXIF orientation
+	if (reader.transformation() & QImageIOHandler::TransformationRotate90)
+		s.transpose();
+
+	return s;
+}
+
+/// <summary>
+/// Parses the image dimensions of the PAGE Page element.
+/// The XML is streamed to its end (without building a tree) to check
+/// that it is well-formed. It is not validated against the PAGE schema.
+/// </summary>
+/// <param name="xmlPath">The PAGE XML path.</param>
+/// <param name="size">The image size specified in the XML.</param>
+/// <param name="error">If not null, it is set to the parser error (empty if the XML is well-formed).</param>
+/// <returns>true if a Page element was found.</returns>
+bool PageXmlValidator::readPageSize(const QString & xmlPath, QSize & size, QString* error) {
+
+	QFile f(xmlPath);
+
+	if (!f.open(QIODevice::ReadOnly))
+		return false;
+
+	QXmlStreamReader reader(&f);
+	bool found = false;
+
+	while (!reader.atEnd()) {
+
+		reader.readNext();
+
+		if (!found && reader.isStartElement() && reader.name() == "Page") {
+			
+			QXmlStreamAttributes attr = reader.attributes();
+			size = QSize(attr.value("imageWidth").toInt(), attr.value("imageHeight").toInt());
+			found = true;
+		}
+	}
+
+	if (reader.hasError()) {
+
+		QString msg = reader.errorString() + " (line " + QString::number(reader.lineNumber()) + ")";
+		qDebug() << "could not parse" << xmlPath << msg;
+
+		if (error)
+			*error = msg;
+	}
+
+	return found;
+}
+
+/// <summary>
+/// Returns all images of a directory that are supported by Qt.
+/// </summary>
+QStringList PageXmlValidator::imageFiles(const QString & dirPath) {
+
+	QStringList filters;
+	for (const QByteArray& f : QImageReader::supportedImageFormats())
+		filters << "*." + QString::fromLatin1(f);
+
+	QDir dir(dirPath);
+	QStringList files;
+
+	for (const QFileInfo& fi : dir.entryInfoList(filters, QDir::Files, QDir::Name))
+		files << fi.absoluteFilePath();
+
+	return files;
+}
+
+/// <summary>
+/// Validates all images of a directory concurrently.
+/// </summary>
+/// <param name="dirPath">The directory path.</param>
+/// <returns>A validator for each image.</returns>
+QVector<PageXmlValidator> PageXmlValidator::validateDirectory(const QString & dirPath) {
+
+	QVector<PageXmlValidator> validators;
+
+	for (const QString& fp : imageFiles(dirPath))
+		validators << PageXmlValidator(fp);
+
+	QtConcurrent::blockingMap(validators, [](PageXmlValidator& v) {
+		v.validate();
+	});
+
+	return validators;
+}
+
+bool PageXmlValidator::fixEmptyXml() {
+
+	rdf::PageXmlParser parser;
+	parser.read(xmlPath());
+
+	if (parser.loadStatus() != rdf::PageXmlParser::status_file_empty) {
+		mStatus = parser.loadStatusMessage();
+		return false;
+	}
+
+	// set minimally required values
+	parser.page()->setImageFileName(QFileInfo(mImgPath).fileName());
+	parser.page()->setImageSize(mImageSize);
+
+	// save xml
+	parser.write(xmlPath(), parser.page());
+	mStatus = "XML fixed";
+
+	return true;
+}
+
+}
@@ -0,0 +1,83 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QString>
+#include <QSize>
+#include <QVector>
+#include <QStringList>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+/// <summary>
+/// Fast validation of PAGE XMLs.
+/// The image size is read from the image's header (if it
+/// is not set) and the XML is streamed to check that it is
+/// well-formed and to read the Page element. Hence, neither
+/// the image is decoded nor the region tree is built.
+/// NOTE: the XML is not validated against the PAGE schema.
+/// </summary>
+class PageXmlValidator {
+
+public:
+	PageXmlValidator(const QString& imgPath = QString());
+
+	bool validate();
+
+	QString imagePath() const;
+	QString xmlPath() const;
+	QString status() const;
+
+	void setImageSize(const QSize& size);
+	QSize imageSize() const;
+	QSize pageSize() const;
+
+	static QSize readImageSize(const QString& imgPath);
+	static bool readPageSize(const QString& xmlPath, QSize& size, QString* error = 0);
+
+	static QStringList imageFiles(const QString& dirPath);
+	static QVector<PageXmlValidator> validateDirectory(const QString& dirPath);
+
+private:
+	QString mImgPath;
+	QString mStatus;
+
+	QSize mImageSize;
+	QSize mPageSize;
+
+	bool fixEmptyXml();
+};
+
+};
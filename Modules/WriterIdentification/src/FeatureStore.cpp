@@ -0,0 +1,343 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#include "FeatureStore.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QDebug>
+#include <QSaveFile>
+
+#include <cstring>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+namespace {
+
+	const char featureMagic[4] = { 'R', 'D', 'F', 'S' };
+	const quint32 featureVersion = 1;
+
+	// all values are little endian (native on our platforms)
+	struct FeatureHeader {
+		char magic[4];
+		quint32 version;
+		quint32 numKeyPoints;
+		quint32 rows;			// descriptor rows
+		quint32 cols;			// descriptor cols
+		qint32 type;			// OpenCV type of the descriptors
+		quint64 descOffset;		// byte offset of the descriptor matrix
+	};
+
+	struct KeyPointRecord {
+		float x;
+		float y;
+		float size;
+		float angle;
+		float response;
+		qint32 octave;
+		qint32 classId;
+	};
+
+	quint64 alignedOffset(quint64 offset) {
+		return (offset + 15) & ~quint64(15);
+	}
+}
+
+// FeatureStore --------------------------------------------------------------------
+FeatureStore::FeatureStore(const QString& filePath) {
+	mFilePath = filePath;
+}
+
+/// <summary>
+/// Reads the feature file.
+/// Binary files are mapped, the descriptors returned by descriptors()
+/// are only valid as long as this object exists.
+/// </summary>
+/// <returns>true if keypoints and descriptors could be read.</returns>
+bool FeatureStore::read() {
+
+	if (isBinaryFile(mFilePath))
+		return readBinary();
+
+	return readYaml();
+}
+
+/// <summary>
+/// Writes the keypoints and descriptors to the binary container.
+/// </summary>
+/// <param name="keyPoints">The keypoints.</param>
+/// <param name="descriptors">The descriptors (one row per keypoint).</param>
+/// <returns>true on success.</returns>
+bool FeatureStore::write(const QVector<cv::KeyPoint>& keyPoints, const cv::Mat & descriptors) const {
+
+	if (!descriptors.empty() && descriptors.rows != keyPoints.size()) {
+		mError = QString("%1 keypoints but %2 descriptors").arg(keyPoints.size()).arg(descriptors.rows);
+		return false;
+	}
+
+	FeatureHeader h;
+	memcpy(h.magic, featureMagic, sizeof(featureMagic));
+	h.version = featureVersion;
+	h.numKeyPoints = keyPoints.size();
+	h.rows = descriptors.rows;
+	h.cols = descriptors.cols;
+	h.type = descriptors.empty() ? CV_32FC1 : descriptors.type();
+	h.descOffset = alignedOffset(sizeof(FeatureHeader) + keyPoints.size() * sizeof(KeyPointRecord));
+
+	QByteArray kpData(keyPoints.size() * (int)sizeof(KeyPointRecord), 0);
+	KeyPointRecord* kpr = (KeyPointRecord*)kpData.data();
+
+	for (const cv::KeyPoint& kp : keyPoints) {
+		kpr->x = kp.pt.x;
+		kpr->y = kp.pt.y;
+		kpr->size = kp.size;
+		kpr->angle = kp.angle;
+		kpr->response = kp.response;
+		kpr->octave = kp.octave;
+		kpr->classId = kp.class_id;
+		kpr++;
+	}
+
+	QSaveFile f(mFilePath);
+	if (!f.open(QIODevice::WriteOnly)) {
+		mError = "could not open " + mFilePath + " for writing";
+		return false;
+	}
+
+	f.write((const char*)&h, sizeof(h));
+	f.write(kpData);
+	f.write(QByteArray((int)(h.descOffset - sizeof(h) - kpData.size()), 0));
+
+	// write row by row - the matrix might not be continuous
+	for (int rIdx = 0; rIdx < descriptors.rows; rIdx++)
+		f.write((const char*)descriptors.ptr(rIdx), descriptors.cols * descriptors.elemSize());
+
+	if (!f.commit()) {
+		mError = "could not write " + mFilePath;
+		return false;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Writes the features in the yml format of rdf::WriterImage::saveFeatures.
+/// This is needed for rdf functions that read feature files themselves.
+/// </summary>
+/// <param name="filePath">The yml file path.</param>
+/// <returns>true on success.</returns>
+bool FeatureStore::writeYaml(const QString & filePath) const {
+
+	cv::FileStorage fs(filePath.toStdString(), cv::FileStorage::WRITE);
+	if (!fs.isOpened()) {
+		mError = "could not open " + filePath + " for writing";
+		return false;
+	}
+
+	cv::write(fs, "keypoints", mKeyPoints);
+	fs << "descriptors" << mDescriptors;
+	fs.release();
+
+	return true;
+}
+
+/// <summary>
+/// Sets keypoints and descriptors (e.g. to write them with writeYaml).
+/// </summary>
+void FeatureStore::setFeatures(const std::vector<cv::KeyPoint>& keyPoints, const cv::Mat & descriptors) {
+	mKeyPoints = keyPoints;
+	mDescriptors = descriptors;
+	mBinary = false;
+	mFile.clear();
+}
+
+bool FeatureStore::isEmpty() const {
+	return mKeyPoints.empty();
+}
+
+bool FeatureStore::isBinary() const {
+	return mBinary;
+}
+
+QString FeatureStore::filePath() const {
+	return mFilePath;
+}
+
+QString FeatureStore::errorString() const {
+	return mError;
+}
+
+std::vector<cv::KeyPoint> FeatureStore::keyPoints() const {
+	return mKeyPoints;
+}
+
+/// <summary>
+/// Returns the descriptors.
+/// NOTE: for binary files this is a view on the mapped file.
+/// </summary>
+cv::Mat FeatureStore::descriptors() const {
+	return mDescriptors;
+}
+
+/// <summary>
+/// Returns true if filePath starts with the binary feature header.
+/// </summary>
+bool FeatureStore::isBinaryFile(const QString & filePath) {
+
+	QFile f(filePath);
+	if (!f.open(QIODevice::ReadOnly))
+		return false;
+
+	QByteArray magic = f.read(sizeof(featureMagic));
+
+	return magic.size() == sizeof(featureMagic) && memcmp(magic.constData(), featureMagic, sizeof(featureMagic)) == 0;
+}
+
+/// <summary>
+/// Removes keypoints (and their descriptors) whose SIFT patch size
+/// (size * 1.5 * 4) is out of [minSize maxSize].
+/// A keep mask is computed first, then both arrays are compacted
+/// in a single pass with one allocation for the descriptors.
+/// </summary>
+/// <param name="keyPoints">The keypoints (filtered in place).</param>
+/// <param name="descriptors">The descriptors (replaced by the filtered matrix).</param>
+/// <param name="minSize">The minimum patch size.</param>
+/// <param name="maxSize">The maximum patch size (0 = no upper limit).</param>
+/// <returns>The number of removed keypoints or -1 if the number of descriptors does not match the keypoints (nothing is filtered).</returns>
+int FeatureStore::filterKeyPoints(std::vector<cv::KeyPoint>& keyPoints, cv::Mat & descriptors, double minSize, double maxSize) {
+
+	int numKp = (int)keyPoints.size();
+
+	if (descriptors.rows != numKp)
+		return -1;
+
+	std::vector<uchar> keep(numKp);
+	int numKeep = 0;
+
+	for (int idx = 0; idx < numKp; idx++) {
+		double s = keyPoints[idx].size * 1.5 * 4;
+		keep[idx] = !((maxSize > 0 && s > maxSize) || s < minSize);
+		numKeep += keep[idx];
+	}
+
+	if (numKeep == numKp)
+		return 0;
+
+	cv::Mat filtered(numKeep, descriptors.cols, descriptors.type());
+	size_t rowBytes = descriptors.cols * descriptors.elemSize();
+	int wIdx = 0;
+
+	for (int idx = 0; idx < numKp; idx++) {
+
+		if (!keep[idx])
+			continue;
+
+		keyPoints[wIdx] = keyPoints[idx];
+		memcpy(filtered.ptr(wIdx), descriptors.ptr(idx), rowBytes);
+		wIdx++;
+	}
+
+	keyPoints.resize(numKeep);
+	descriptors = filtered;
+
+	return numKp - numKeep;
+}
+
+QString FeatureStore::extension() {
+	return ".sift";
+}
+
+bool FeatureStore::readBinary() {
+
+	mFile = QSharedPointer<QFile>(new QFile(mFilePath));
+
+	if (!mFile->open(QIODevice::ReadOnly)) {
+		mError = "could not open " + mFilePath;
+		return false;
+	}
+
+	qint64 size = mFile->size();
+	const uchar* data = mFile->map(0, size);
+
+	if (!data || size < (qint64)sizeof(FeatureHeader)) {
+		mError = "could not map " + mFilePath;
+		return false;
+	}
+
+	FeatureHeader h;
+	memcpy(&h, data, sizeof(h));
+
+	if (h.version != featureVersion) {
+		mError = QString("unsupported feature file version %1 in %2").arg(h.version).arg(mFilePath);
+		return false;
+	}
+
+	quint64 kpEnd = sizeof(FeatureHeader) + (quint64)h.numKeyPoints * sizeof(KeyPointRecord);
+	quint64 descSize = (quint64)h.rows * h.cols * CV_ELEM_SIZE(h.type);
+
+	if (kpEnd > h.descOffset || h.descOffset + descSize > (quint64)size || h.rows != h.numKeyPoints) {
+		mError = "corrupted feature file: " + mFilePath;
+		return false;
+	}
+
+	const KeyPointRecord* kpr = (const KeyPointRecord*)(data + sizeof(FeatureHeader));
+	mKeyPoints.resize(h.numKeyPoints);
+
+	for (cv::KeyPoint& kp : mKeyPoints) {
+		kp = cv::KeyPoint(kpr->x, kpr->y, kpr->size, kpr->angle, kpr->response, kpr->octave, kpr->classId);
+		kpr++;
+	}
+
+	if (h.rows > 0)
+		mDescriptors = cv::Mat(h.rows, h.cols, h.type, (void*)(data + h.descOffset));
+	mBinary = true;
+
+	return true;
+}
+
+bool FeatureStore::readYaml() {
+
+	cv::FileStorage fs(mFilePath.toStdString(), cv::FileStorage::READ);
+	if (!fs.isOpened()) {
+		mError = "unable to read file " + mFilePath;
+		return false;
+	}
+
+	fs["keypoints"] >> mKeyPoints;
+	fs["descriptors"] >> mDescriptors;
+	fs.release();
+	mBinary = false;
+
+	return true;
+}
+
+};
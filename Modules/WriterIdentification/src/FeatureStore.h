@@ -0,0 +1,87 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QString>
+#include <QFile>
+#include <QVector>
+#include <QSharedPointer>
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+/// <summary>
+/// Binary container for SIFT keypoints and descriptors.
+/// The file consists of a fixed header, the keypoint array
+/// and the row-major descriptor matrix. Binary files are
+/// memory mapped, yml files (rdf::WriterImage::saveFeatures)
+/// are still read using cv::FileStorage.
+/// </summary>
+class FeatureStore {
+
+public:
+	FeatureStore(const QString& filePath = QString());
+
+	bool read();
+	bool write(const QVector<cv::KeyPoint>& keyPoints, const cv::Mat& descriptors) const;
+	bool writeYaml(const QString& filePath) const;
+	void setFeatures(const std::vector<cv::KeyPoint>& keyPoints, const cv::Mat& descriptors);
+
+	bool isEmpty() const;
+	bool isBinary() const;
+	QString filePath() const;
+	QString errorString() const;
+
+	std::vector<cv::KeyPoint> keyPoints() const;
+	cv::Mat descriptors() const;
+
+	static bool isBinaryFile(const QString& filePath);
+	static int filterKeyPoints(std::vector<cv::KeyPoint>& keyPoints, cv::Mat& descriptors, double minSize, double maxSize);
+	static QString extension();
+
+private:
+	QString mFilePath;
+	mutable QString mError;
+	QSharedPointer<QFile> mFile;			// keeps the mapping alive
+	std::vector<cv::KeyPoint> mKeyPoints;
+	cv::Mat mDescriptors;					// view on the mapped memory (binary files)
+	bool mBinary = false;
+
+	bool readBinary();
+	bool readYaml();
+};
+
+};
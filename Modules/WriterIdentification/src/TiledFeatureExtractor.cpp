@@ -0,0 +1,269 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#include "TiledFeatureExtractor.h"
+
+#include "FeatureStore.h"
+#include "WriterRetrieval.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QDebug>
+#include <QHash>
+#include <QtConcurrentMap>
+#include <QtMath>
+
+#include <cmath>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+namespace {
+
+	struct FeatureTile {
+		cv::Rect core;		// keypoints within this rect are kept
+		cv::Rect roi;		// core + overlap
+		QVector<cv::KeyPoint> keyPoints;
+		cv::Mat descriptors;
+	};
+}
+
+// TiledFeatureExtractor --------------------------------------------------------------------
+TiledFeatureExtractor::TiledFeatureExtractor(int tileSize, int overlap, int alignment) {
+
+	mAlignment = qMax(1, alignment);
+
+	// round up to the next multiple of the alignment
+	mTileSize = (tileSize + mAlignment - 1) / mAlignment * mAlignment;
+	mOverlap = (overlap + mAlignment - 1) / mAlignment * mAlignment;
+}
+
+/// <summary>
+/// Returns the overlap that is needed so that all keypoints which pass
+/// the size filter (size * 1.5 * 4 <= maxSIFTSize, see FeatureStore::filterKeyPoints)
+/// see the same support as on the whole page (if the tiles are aligned, see alignmentFor).
+/// The largest support of a SIFT keypoint is its descriptor window
+/// (radius 3 * sqrt(2) * 5/2 * sigma with sigma = size/2, i.e. ~5.3 * size).
+/// The orientation window (4.5 * sigma) and the detector's border (5 px per octave)
+/// are smaller. Hence, an overlap of maxSIFTSize (= 6 * size) covers all of them.
+/// </summary>
+/// <param name="maxSIFTSize">The maximum SIFT size of the vocabulary (must be > 0).</param>
+int TiledFeatureExtractor::overlapFor(double maxSIFTSize) {
+	return qCeil(maxSIFTSize);
+}
+
+/// <summary>
+/// Returns the alignment of tile origins & sizes that is needed so that the
+/// octaves of all keypoints which pass the size filter sample the same pixels
+/// as on the whole page. SIFT (sigma = 1.6, the image is upsampled once)
+/// detects a keypoint of size s in the octave floor(log2(s / 1.6)) which samples
+/// every 2^(octave - 1) pixel of the page. Hence, 2^octave is a safe alignment.
+/// </summary>
+/// <param name="maxSIFTSize">The maximum SIFT size of the vocabulary (must be > 0).</param>
+int TiledFeatureExtractor::alignmentFor(double maxSIFTSize) {
+
+	double maxSize = maxSIFTSize / (1.5 * 4);	// largest keypoint size that passes the filter
+	int octave = maxSize > 1.6 ? qFloor(std::log2(maxSize / 1.6)) : 0;
+
+	return 1 << qBound(0, octave, 12);
+}
+
+/// <summary>
+/// Extracts the features of img.
+/// </summary>
+/// <param name="img">The page image.</param>
+/// <param name="mask">An optional mask (features are only computed where mask != 0).</param>
+/// <returns>true if features were computed.</returns>
+bool TiledFeatureExtractor::compute(const cv::Mat & img, const cv::Mat & mask) {
+
+	mKeyPoints.clear();
+	mDescriptors = cv::Mat();
+
+	if (img.empty() || mTileSize <= 0)
+		return false;
+
+	cv::Rect imgRect(0, 0, img.cols, img.rows);
+	QVector<FeatureTile> tiles;
+
+	for (int y = 0; y < img.rows; y += mTileSize) {
+		for (int x = 0; x < img.cols; x += mTileSize) {
+
+			FeatureTile t;
+			t.core = cv::Rect(x, y, mTileSize, mTileSize) & imgRect;
+			t.roi = cv::Rect(x - mOverlap, y - mOverlap, mTileSize + 2 * mOverlap, mTileSize + 2 * mOverlap) & imgRect;
+
+			// skip tiles without any text
+			if (!mask.empty() && cv::countNonZero(mask(t.core)) == 0)
+				continue;
+
+			tiles << t;
+		}
+	}
+
+	QtConcurrent::blockingMap(tiles, [&](FeatureTile& t) {
+
+		rdf::WriterImage wi = rdf::WriterImage();
+		wi.setImage(img(t.roi).clone());
+		if (!mask.empty())
+			wi.setMask(mask(t.roi).clone());
+		wi.calculateFeatures();
+
+		QVector<cv::KeyPoint> kp = wi.keyPoints();
+		cv::Mat desc = wi.descriptors();
+		cv::Rect_<float> core(t.core);
+
+		t.descriptors = cv::Mat(0, desc.cols, desc.type());
+
+		for (int idx = 0; idx < kp.size(); idx++) {
+
+			cv::KeyPoint k = kp[idx];
+			k.pt.x += t.roi.x;
+			k.pt.y += t.roi.y;
+
+			// the keypoint belongs to a neighbouring tile
+			if (!core.contains(k.pt))
+				continue;
+
+			t.keyPoints << k;
+			t.descriptors.push_back(desc.row(idx));
+		}
+	});
+
+	for (const FeatureTile& t : tiles) {
+
+		if (t.keyPoints.empty())
+			continue;
+
+		mKeyPoints << t.keyPoints;
+		mDescriptors.push_back(t.descriptors);
+	}
+
+	qDebug() << mKeyPoints.size() << "keypoints extracted from" << tiles.size() << "tiles";
+
+	return true;
+}
+
+/// <summary>
+/// Compares the tiled features (compute() must be called first) with the features of the whole page.
+/// Both are filtered by size (maxSIFTSize) first. Two keypoints agree if their
+/// position (0.5 px), size (1%) and angle (1 degree) match and the distance of
+/// their descriptors is below 5% of the descriptor's norm.
+/// This extracts the whole page - use it to check the tiling on a sample page.
+/// </summary>
+/// <param name="img">The page image (the one passed to compute()).</param>
+/// <param name="mask">The mask (the one passed to compute()).</param>
+/// <param name="maxSIFTSize">The maximum SIFT size of the vocabulary.</param>
+/// <returns>The fraction of keypoints that agree [0 1] (matches / max(#page keypoints, #tiled keypoints)).</returns>
+double TiledFeatureExtractor::agreement(const cv::Mat & img, const cv::Mat & mask, double maxSIFTSize) const {
+
+	rdf::WriterImage wi = rdf::WriterImage();
+	wi.setImage(img);
+	if (!mask.empty())
+		wi.setMask(mask);
+	wi.calculateFeatures();
+
+	std::vector<cv::KeyPoint> pageKp = wi.keyPoints().toStdVector();
+	cv::Mat pageDesc = wi.descriptors();
+	std::vector<cv::KeyPoint> tiledKp = mKeyPoints.toStdVector();
+	cv::Mat tiledDesc = mDescriptors;
+
+	if (FeatureStore::filterKeyPoints(pageKp, pageDesc, 0, maxSIFTSize) < 0 ||
+		FeatureStore::filterKeyPoints(tiledKp, tiledDesc, 0, maxSIFTSize) < 0) {
+		qWarning() << "keypoints and descriptors do not match - cannot compare the tiling";
+		return 0.0;
+	}
+
+	if (pageKp.empty() && tiledKp.empty())
+		return 1.0;
+
+	// index the tiled keypoints by pixel
+	auto cell = [](const cv::Point2f& pt) {
+		return ((qint64)qFloor(pt.y) << 32) | (quint32)qFloor(pt.x);
+	};
+
+	QHash<qint64, QVector<int> > grid;
+	for (int idx = 0; idx < (int)tiledKp.size(); idx++)
+		grid[cell(tiledKp[idx].pt)] << idx;
+
+	QVector<bool> used(tiledKp.size(), false);
+	int numMatches = 0;
+
+	for (int pIdx = 0; pIdx < (int)pageKp.size(); pIdx++) {
+
+		const cv::KeyPoint& pk = pageKp[pIdx];
+		cv::Mat pd = pageDesc.row(pIdx);
+		double maxDescDist = 0.05 * cv::norm(pd);
+
+		int match = -1;
+
+		for (int dy = -1; dy <= 1 && match < 0; dy++) {
+			for (int dx = -1; dx <= 1 && match < 0; dx++) {
+
+				for (int tIdx : grid.value(cell(cv::Point2f(pk.pt.x + dx, pk.pt.y + dy)))) {
+
+					const cv::KeyPoint& tk = tiledKp[tIdx];
+					double da = std::abs(pk.angle - tk.angle);
+					da = std::min(da, 360.0 - da);
+
+					if (used[tIdx] ||
+						cv::norm(pk.pt - tk.pt) > 0.5 ||
+						std::abs(pk.size - tk.size) > 0.01 * pk.size ||
+						da > 1.0 ||
+						cv::norm(pd, tiledDesc.row(tIdx), cv::NORM_L2) > maxDescDist)
+						continue;
+
+					match = tIdx;
+					break;
+				}
+			}
+		}
+
+		if (match >= 0) {
+			used[match] = true;
+			numMatches++;
+		}
+	}
+
+	double a = (double)numMatches / qMax(pageKp.size(), tiledKp.size());
+	qInfo() << "tiled SIFT:" << numMatches << "of" << pageKp.size() << "page keypoints and" << tiledKp.size() << "tiled keypoints agree (" << a * 100 << "%)";
+
+	return a;
+}
+
+QVector<cv::KeyPoint> TiledFeatureExtractor::keyPoints() const {
+	return mKeyPoints;
+}
+
+cv::Mat TiledFeatureExtractor::descriptors() const {
+	return mDescriptors;
+}
+
+};
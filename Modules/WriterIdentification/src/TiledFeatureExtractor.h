@@ -0,0 +1,78 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QVector>
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+/// <summary>
+/// Computes rdf::WriterImage features on overlapping tiles concurrently.
+/// Each tile is extracted with its overlap (so that keypoints at the seams
+/// see their full support) but only keypoints within the tile's core are
+/// kept. Hence, every keypoint is reported by exactly one tile.
+/// Tile origins and sizes are multiples of the alignment (see alignmentFor)
+/// so that the downsampled octaves of a tile sample the same pixels as the
+/// whole page's octaves.
+/// Keypoints whose support fits into the overlap (see overlapFor) should then
+/// match the whole page extraction - use agreement() to check this on a sample page.
+/// Larger keypoints may differ - they must be filtered (maxSIFTSize) before the features are used.
+/// </summary>
+class TiledFeatureExtractor {
+
+public:
+	TiledFeatureExtractor(int tileSize = 2048, int overlap = 128, int alignment = 1);
+
+	bool compute(const cv::Mat& img, const cv::Mat& mask = cv::Mat());
+	double agreement(const cv::Mat& img, const cv::Mat& mask, double maxSIFTSize) const;
+
+	QVector<cv::KeyPoint> keyPoints() const;
+	cv::Mat descriptors() const;
+
+	static int overlapFor(double maxSIFTSize);
+	static int alignmentFor(double maxSIFTSize);
+
+private:
+	int mTileSize = 2048;	// multiple of mAlignment
+	int mOverlap = 128;		// must exceed the support of the largest SIFT keypoint (see overlapFor), multiple of mAlignment
+	int mAlignment = 1;		// tile origins & sizes are multiples of it (see alignmentFor)
+
+	QVector<cv::KeyPoint> mKeyPoints;
+	cv::Mat mDescriptors;
+};
+
+};
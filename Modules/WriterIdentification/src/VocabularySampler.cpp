@@ -0,0 +1,209 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#include "VocabularySampler.h"
+#include "FeatureStore.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QDebug>
+#include <QHash>
+#include <QtConcurrentMap>
+
+#include <cstring>
+#include <limits>
+#include <numeric>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+namespace {
+
+	void copyRow(const DescriptorSample& src, int srcIdx, DescriptorSample& dst, int dstIdx) {
+		dst.keyPoints[dstIdx] = src.keyPoints[srcIdx];
+		memcpy(dst.descriptors.ptr(dstIdx), src.descriptors.ptr(srcIdx), src.descriptors.cols * src.descriptors.elemSize());
+	}
+
+	struct FileSampler {
+		typedef DescriptorSample result_type;
+
+		int maxSamples;
+		double minSIFTSize;
+		double maxSIFTSize;
+
+		DescriptorSample operator()(const QString& filePath) const {
+			return VocabularySampler::sampleFile(filePath, maxSamples, minSIFTSize, maxSIFTSize);
+		}
+	};
+
+	struct SampleReducer {
+		int maxSamples;
+		mutable cv::RNG rng;
+
+		void operator()(DescriptorSample& dst, const DescriptorSample& src) const {
+			VocabularySampler::merge(dst, src, maxSamples, rng);
+		}
+	};
+}
+
+// VocabularySampler --------------------------------------------------------------------
+VocabularySampler::VocabularySampler(int maxSamples, double minSIFTSize, double maxSIFTSize) {
+	mMaxSamples = maxSamples > 0 ? maxSamples : std::numeric_limits<int>::max();
+	mMinSIFTSize = minSIFTSize;
+	mMaxSIFTSize = maxSIFTSize;
+}
+
+/// <summary>
+/// Samples the descriptors of all feature files concurrently.
+/// The samples are merged in file order, so the result is reproducible.
+/// </summary>
+/// <param name="featurePaths">The feature files (binary or yml).</param>
+/// <returns>The merged sample.</returns>
+DescriptorSample VocabularySampler::sample(const QStringList & featurePaths) const {
+
+	FileSampler fs = { mMaxSamples, mMinSIFTSize, mMaxSIFTSize };
+	SampleReducer sr = { mMaxSamples, cv::RNG(0x5eed) };
+
+	return QtConcurrent::blockingMappedReduced<DescriptorSample>(featurePaths, fs, sr, QtConcurrent::OrderedReduce);
+}
+
+/// <summary>
+/// Reads a feature file, filters its keypoints by size and
+/// draws at most maxSamples descriptors.
+/// </summary>
+DescriptorSample VocabularySampler::sampleFile(const QString & filePath, int maxSamples, double minSIFTSize, double maxSIFTSize) {
+
+	DescriptorSample s;
+	FeatureStore store(filePath);
+
+	if (!store.read()) {
+		qWarning() << store.errorString() << "... skipping";
+		return s;
+	}
+
+	std::vector<cv::KeyPoint> kp = store.keyPoints();
+	cv::Mat desc = store.descriptors();
+
+	if (desc.rows != (int)kp.size()) {
+		qWarning() << "keypoints and descriptors do not match in" << filePath << "... skipping";
+		return s;
+	}
+
+	if (minSIFTSize > 0 || maxSIFTSize > 0)
+		FeatureStore::filterKeyPoints(kp, desc, minSIFTSize, maxSIFTSize);
+
+	s.numSeen = kp.size();
+
+	if ((int)kp.size() <= maxSamples) {
+		s.keyPoints = kp;
+		s.descriptors = desc.clone();	// we must not keep views on the mapped file
+		return s;
+	}
+
+	std::vector<int> idx(kp.size());
+	std::iota(idx.begin(), idx.end(), 0);
+	cv::RNG rng(qHash(filePath));
+	cv::randShuffle(idx, 1.0, &rng);
+
+	DescriptorSample all;
+	all.keyPoints = kp;
+	all.descriptors = desc;
+
+	s.keyPoints.resize(maxSamples);
+	s.descriptors.create(maxSamples, desc.cols, desc.type());
+
+	for (int rIdx = 0; rIdx < maxSamples; rIdx++)
+		copyRow(all, idx[rIdx], s, rIdx);
+
+	return s;
+}
+
+/// <summary>
+/// Merges src into dst so that dst is a random sample of both.
+/// Each row is drawn from dst or src proportionally to the number
+/// of descriptors the remaining rows of each sample represent.
+/// </summary>
+void VocabularySampler::merge(DescriptorSample & dst, const DescriptorSample & src, int maxSamples, cv::RNG & rng) {
+
+	if (src.descriptors.empty())
+		return;
+
+	if (dst.descriptors.empty() && dst.numSeen == 0) {
+		dst = src;
+		return;
+	}
+
+	int numDst = dst.descriptors.rows;
+	int numSrc = src.descriptors.rows;
+
+	// neither sample was reduced - just append
+	if (numDst + numSrc <= maxSamples) {
+		dst.keyPoints.insert(dst.keyPoints.end(), src.keyPoints.begin(), src.keyPoints.end());
+		dst.descriptors.push_back(src.descriptors);
+		dst.numSeen += src.numSeen;
+		return;
+	}
+
+	std::vector<int> dIdx(numDst), sIdx(numSrc);
+	std::iota(dIdx.begin(), dIdx.end(), 0);
+	std::iota(sIdx.begin(), sIdx.end(), 0);
+	cv::randShuffle(dIdx, 1.0, &rng);
+	cv::randShuffle(sIdx, 1.0, &rng);
+
+	double wDst = (double)dst.numSeen;
+	double wSrc = (double)src.numSeen;
+	double dDst = wDst / numDst;	// descriptors represented by a single row
+	double dSrc = wSrc / numSrc;
+
+	DescriptorSample m;
+	m.keyPoints.resize(maxSamples);
+	m.descriptors.create(maxSamples, dst.descriptors.cols, dst.descriptors.type());
+	m.numSeen = dst.numSeen + src.numSeen;
+
+	int di = 0, si = 0;
+	for (int rIdx = 0; rIdx < maxSamples; rIdx++) {
+
+		bool fromDst = si >= numSrc || (di < numDst && rng.uniform(0.0, wDst + wSrc) < wDst);
+
+		if (fromDst) {
+			copyRow(dst, dIdx[di++], m, rIdx);
+			wDst -= dDst;
+		}
+		else {
+			copyRow(src, sIdx[si++], m, rIdx);
+			wSrc -= dSrc;
+		}
+	}
+
+	dst = m;
+}
+
+};
@@ -0,0 +1,76 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QStringList>
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+/// <summary>
+/// Uniform random subset of all descriptors of a set of feature files.
+/// </summary>
+struct DescriptorSample {
+	std::vector<cv::KeyPoint> keyPoints;
+	cv::Mat descriptors;		// one row per keypoint
+	qint64 numSeen = 0;			// number of descriptors this sample was drawn from
+};
+
+/// <summary>
+/// Draws a bounded random sample of descriptors for vocabulary training.
+/// Feature files are read and filtered concurrently, each file is reduced
+/// to a reservoir of at most maxSamples descriptors which are then merged
+/// (weighted by the number of descriptors they represent).
+/// Memory is bounded by maxSamples rather than by the number of pages.
+/// The vocabulary is fitted on the sample by the VocabularyTrainer.
+/// </summary>
+class VocabularySampler {
+
+public:
+	VocabularySampler(int maxSamples, double minSIFTSize = 0, double maxSIFTSize = 0);
+
+	DescriptorSample sample(const QStringList& featurePaths) const;
+
+	static DescriptorSample sampleFile(const QString& filePath, int maxSamples, double minSIFTSize, double maxSIFTSize);
+	static void merge(DescriptorSample& dst, const DescriptorSample& src, int maxSamples, cv::RNG& rng);
+
+private:
+	int mMaxSamples = 0;		// <= 0 means all descriptors
+	double mMinSIFTSize = 0;
+	double mMaxSIFTSize = 0;
+};
+
+};
@@ -0,0 +1,117 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#include "VocabularyTrainer.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QDebug>
+#include <opencv2/ml.hpp>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+// VocabularyTrainer --------------------------------------------------------------------
+VocabularyTrainer::VocabularyTrainer(const rdf::WriterVocabulary & voc) {
+	mVoc = voc;
+}
+
+/// <summary>
+/// Fits the PCA and the clusters of the vocabulary's type on descriptors.
+/// The PCA (mean, eigenvectors and eigenvalues) is stored in the vocabulary
+/// and the clusters are fitted on the projected descriptors. GMMs use
+/// diagonal covariances.
+/// </summary>
+/// <param name="descriptors">The descriptors (one row per keypoint).</param>
+/// <returns>false if the vocabulary could not be fitted (see errorString()).</returns>
+bool VocabularyTrainer::train(const cv::Mat & descriptors) {
+
+	int numClusters = mVoc.numberOfCluster();
+
+	if (descriptors.rows < numClusters) {
+		mError = QString("%1 descriptors are not enough for %2 clusters").arg(descriptors.rows).arg(numClusters);
+		return false;
+	}
+
+	cv::Mat data;
+	descriptors.convertTo(data, CV_32F);
+
+	if (mVoc.numberOfPCA() > 0) {
+
+		cv::PCA pca(data, cv::noArray(), cv::PCA::DATA_AS_ROW, mVoc.numberOfPCA());
+		mVoc.setPcaMean(pca.mean);
+		mVoc.setPcaEigenvectors(pca.eigenvectors);
+		mVoc.setPcaEigenvalues(pca.eigenvalues);
+
+		data = pca.project(data);
+	}
+
+	cv::TermCriteria tc(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, mMaxIterations, 1e-4);
+	cv::Mat labels, centers;
+	cv::kmeans(data, numClusters, labels, tc, 1, cv::KMEANS_PP_CENTERS, centers);
+
+	if (mVoc.type() == rdf::WriterVocabulary::WI_BOW) {
+		mVoc.setVocabulary(centers);
+		return true;
+	}
+
+	if (mVoc.type() != rdf::WriterVocabulary::WI_GMM) {
+		mError = "unknown vocabulary type: " + QString::number(mVoc.type());
+		return false;
+	}
+
+	cv::Ptr<cv::ml::EM> em = cv::ml::EM::create();
+	em->setClustersNumber(numClusters);
+	em->setCovarianceMatrixType(cv::ml::EM::COV_MAT_DIAGONAL);
+	em->setTermCriteria(cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, mEMIterations, 1e-4));
+
+	cv::Mat centers64;
+	centers.convertTo(centers64, CV_64F);
+
+	if (!em->trainE(data, centers64)) {
+		mError = "could not fit the GMM";
+		return false;
+	}
+
+	mVoc.setEM(em);
+
+	return true;
+}
+
+rdf::WriterVocabulary VocabularyTrainer::vocabulary() const {
+	return mVoc;
+}
+
+QString VocabularyTrainer::errorString() const {
+	return mError;
+}
+
+};
@@ -0,0 +1,69 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QString>
+#include <opencv2/core.hpp>
+#pragma warning(pop)		// no warnings from includes - end
+
+#include "WriterRetrieval.h"
+
+namespace rdm {
+
+/// <summary>
+/// Fits a writer vocabulary (PCA + GMM or k-means) on an in-memory descriptor sample
+/// (see VocabularySampler). It replaces rdf::WriterDatabase::generateVocabulary()
+/// which needs the descriptors as yml files.
+/// The clusters are initialized by k-means++ (cv::kmeans runs its assignments
+/// in parallel) so that the (serial) EM refinement converges in a few iterations.
+/// </summary>
+class VocabularyTrainer {
+
+public:
+	VocabularyTrainer(const rdf::WriterVocabulary& voc);
+
+	bool train(const cv::Mat& descriptors);
+
+	rdf::WriterVocabulary vocabulary() const;
+	QString errorString() const;
+
+private:
+	rdf::WriterVocabulary mVoc;
+	QString mError;
+
+	int mMaxIterations = 100;	// k-means & EM iterations
+	int mEMIterations = 10;		// EM refinement after k-means
+};
+
+};
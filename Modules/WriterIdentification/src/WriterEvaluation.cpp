@@ -0,0 +1,304 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#include "WriterEvaluation.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QDebug>
+#include <QFile>
+#include <QHash>
+#include <QTextStream>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <cmath>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+// WriterEvaluation --------------------------------------------------------------------
+const int WriterEvaluation::maxRank;
+
+WriterEvaluation::WriterEvaluation(const cv::Mat& features, const QStringList& labels, Distance distance) {
+
+	features.convertTo(mFeatures, CV_32FC1);
+	mDistance = distance;
+	mLabelNames = labels;
+
+	QHash<QString, int> ids;
+	for (const QString& l : labels) {
+		if (!ids.contains(l))
+			ids.insert(l, ids.size());
+		mLabels << ids.value(l);
+	}
+
+	if (mDistance == dist_cosine) {
+		for (int rIdx = 0; rIdx < mFeatures.rows; rIdx++) {
+			cv::Mat r = mFeatures.row(rIdx);
+			cv::normalize(r, r);
+		}
+	}
+}
+
+/// <summary>
+/// Sets the page names which are written per query (default: the page index).
+/// </summary>
+void WriterEvaluation::setNames(const QStringList & names) {
+	mNames = names;
+}
+
+/// <summary>
+/// Ranks all pages for all queries.
+/// </summary>
+/// <param name="blockSize">The number of queries per block.</param>
+void WriterEvaluation::compute(int blockSize) {
+
+	int n = mFeatures.rows;
+
+	if (n != mLabels.size()) {
+		qWarning() << "number of features" << n << "does not match the number of labels" << mLabels.size();
+		return;
+	}
+
+	mAvgPrecision = QVector<double>(n, -1.0);
+	mFirstHit = QVector<int>(n, maxRank + 1);
+	mFirstMiss = QVector<int>(n, maxRank + 1);
+	mTopRanks = QVector<QVector<QPair<int, float> > >(n);
+
+	// squared norms for the L2 distance
+	cv::Mat sqNorms;
+	if (mDistance == dist_l2)
+		cv::reduce(mFeatures.mul(mFeatures), sqNorms, 1, cv::REDUCE_SUM);
+
+	QVector<int> blocks;
+	for (int bIdx = 0; bIdx < n; bIdx += blockSize)
+		blocks << bIdx;
+
+	QtConcurrent::blockingMap(blocks, [&](int start) {
+
+		int end = qMin(start + blockSize, n);
+		cv::Mat dists;
+
+		// block x n dot products
+		cv::gemm(mFeatures.rowRange(start, end), mFeatures, 1.0, cv::noArray(), 0.0, dists, cv::GEMM_2_T);
+
+		for (int rIdx = 0; rIdx < dists.rows; rIdx++) {
+
+			float* d = dists.ptr<float>(rIdx);
+
+			if (mDistance == dist_cosine) {
+				for (int cIdx = 0; cIdx < n; cIdx++)
+					d[cIdx] = 1.0f - d[cIdx];
+			}
+			else {
+				float qn = sqNorms.at<float>(start + rIdx);
+				const float* sn = sqNorms.ptr<float>();
+				for (int cIdx = 0; cIdx < n; cIdx++)
+					d[cIdx] = std::sqrt(std::max(0.0f, qn + sn[cIdx] - 2.0f * d[cIdx]));
+			}
+
+			evaluateQuery(start + rIdx, d);
+		}
+	});
+}
+
+/// <summary>
+/// Mean average precision.
+/// Like all metrics, it is computed over the queries whose writer has other pages
+/// (a query without relevant pages can neither hit nor be ranked).
+/// </summary>
+double WriterEvaluation::mAP() const {
+
+	double sum = 0;
+
+	for (double ap : mAvgPrecision) {
+		if (ap >= 0)
+			sum += ap;
+	}
+
+	int n = numQueries();
+
+	return n > 0 ? sum / n : 0.0;
+}
+
+/// <summary>
+/// Fraction of queries with at least one page of the same writer in the first k results.
+/// </summary>
+double WriterEvaluation::softTop(int k) const {
+
+	int n = numQueries();
+	if (n == 0)
+		return 0.0;
+
+	int cnt = 0;
+	for (int qIdx = 0; qIdx < mFirstHit.size(); qIdx++)
+		cnt += mAvgPrecision[qIdx] >= 0 && mFirstHit[qIdx] <= k;
+
+	return (double)cnt / n;
+}
+
+/// <summary>
+/// Fraction of queries with only pages of the same writer in the first k results.
+/// </summary>
+double WriterEvaluation::hardTop(int k) const {
+
+	int n = numQueries();
+	if (n == 0)
+		return 0.0;
+
+	int cnt = 0;
+	for (int qIdx = 0; qIdx < mFirstMiss.size(); qIdx++)
+		cnt += mAvgPrecision[qIdx] >= 0 && mFirstMiss[qIdx] > k;
+
+	return (double)cnt / n;
+}
+
+/// <summary>
+/// Returns the number of evaluated queries (pages whose writer has other pages).
+/// </summary>
+int WriterEvaluation::numQueries() const {
+
+	int cnt = 0;
+	for (double ap : mAvgPrecision)
+		cnt += ap >= 0;
+
+	return cnt;
+}
+
+QString WriterEvaluation::toString() const {
+
+	QString msg;
+	msg += "queries: " + QString::number(numQueries()) + " / " + QString::number(mAvgPrecision.size()) + " (pages of writers with a single page are skipped)\n";
+	msg += "mAP: " + QString::number(mAP() * 100, 'f', 2) + "\n";
+
+	for (int k : { 1, 2, 5, 10 })
+		msg += "soft top-" + QString::number(k) + ": " + QString::number(softTop(k) * 100, 'f', 2) + "\n";
+
+	for (int k : { 2, 3, 4 })
+		msg += "hard top-" + QString::number(k) + ": " + QString::number(hardTop(k) * 100, 'f', 2) + "\n";
+
+	return msg;
+}
+
+/// <summary>
+/// Writes the summary followed by one line per query:
+/// page, writer, average precision, first hit, first miss and the top ranked pages (page:writer:distance).
+/// </summary>
+bool WriterEvaluation::write(const QString & filePath) const {
+
+	QFile f(filePath);
+	if (!f.open(QIODevice::WriteOnly | QIODevice::Text)) {
+		qWarning() << "could not open" << filePath << "for writing";
+		return false;
+	}
+
+	auto name = [&](int idx) {
+		return idx < mNames.size() ? mNames[idx] : QString::number(idx);
+	};
+
+	QTextStream ts(&f);
+	ts << toString() << "\n";
+	ts << "query\twriter\tAP\tfirst hit\tfirst miss\ttop " << maxRank << "\n";
+
+	for (int qIdx = 0; qIdx < mTopRanks.size(); qIdx++) {
+
+		ts << name(qIdx) << "\t" << mLabelNames.value(qIdx) << "\t" << mAvgPrecision[qIdx] << "\t" << mFirstHit[qIdx] << "\t" << mFirstMiss[qIdx];
+
+		for (const QPair<int, float>& r : mTopRanks[qIdx])
+			ts << "\t" << name(r.first) << ":" << mLabelNames.value(r.first) << ":" << r.second;
+
+		ts << "\n";
+	}
+
+	return true;
+}
+
+void WriterEvaluation::evaluateQuery(int qIdx, const float * dists) {
+
+	int n = mFeatures.rows;
+	int label = mLabels[qIdx];
+
+	// top ranks (the query itself is excluded)
+	std::vector<std::pair<float, int> > ranked;
+	ranked.reserve(n - 1);
+	std::vector<float> relevant;
+
+	for (int idx = 0; idx < n; idx++) {
+
+		if (idx == qIdx)
+			continue;
+
+		ranked.push_back(std::make_pair(dists[idx], idx));
+
+		if (mLabels[idx] == label)
+			relevant.push_back(dists[idx]);
+	}
+
+	int nTop = qMin(maxRank, (int)ranked.size());
+	std::partial_sort(ranked.begin(), ranked.begin() + nTop, ranked.end());
+
+	QVector<QPair<int, float> >& top = mTopRanks[qIdx];
+	top.reserve(nTop);
+
+	for (int rIdx = 0; rIdx < nTop; rIdx++) {
+		bool same = mLabels[ranked[rIdx].second] == label;
+		top << qMakePair(ranked[rIdx].second, ranked[rIdx].first);
+
+		if (same && mFirstHit[qIdx] > maxRank)
+			mFirstHit[qIdx] = rIdx + 1;
+		else if (!same && mFirstMiss[qIdx] > maxRank)
+			mFirstMiss[qIdx] = rIdx + 1;
+	}
+
+	if (relevant.empty())
+		return;
+
+	// rank of the j-th relevant page = #pages that are closer + 1
+	std::sort(relevant.begin(), relevant.end());
+	std::vector<int> closer(relevant.size() + 1, 0);
+
+	for (const auto& r : ranked) {
+		int p = (int)(std::upper_bound(relevant.begin(), relevant.end(), r.first) - relevant.begin());
+		closer[p]++;
+	}
+
+	double ap = 0;
+	int cnt = 0;
+	for (size_t j = 0; j < relevant.size(); j++) {
+		cnt += closer[j];
+		ap += (double)(j + 1) / (cnt + 1);
+	}
+
+	mAvgPrecision[qIdx] = ap / relevant.size();
+}
+
+};
@@ -0,0 +1,93 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QPair>
+#include <opencv2/core.hpp>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+/// <summary>
+/// Leave-one-out retrieval evaluation of page features.
+/// Every page is used as query against all others. Distances are
+/// computed blockwise with cv::gemm (a block of queries against the
+/// whole database), the blocks are processed concurrently and only the
+/// top ranks are sorted per query. Reports mAP, soft and hard top-k.
+/// Queries whose writer has no other page are skipped by all metrics.
+/// </summary>
+class WriterEvaluation {
+
+public:
+	enum Distance {
+		dist_cosine,
+		dist_l2
+	};
+
+	WriterEvaluation(const cv::Mat& features, const QStringList& labels, Distance distance = dist_cosine);
+
+	void setNames(const QStringList& names);
+
+	void compute(int blockSize = 64);
+
+	double mAP() const;
+	double softTop(int k) const;
+	double hardTop(int k) const;
+	int numQueries() const;
+
+	QString toString() const;
+	bool write(const QString& filePath) const;
+
+private:
+	cv::Mat mFeatures;			// CV_32F, one page per row
+	QVector<int> mLabels;		// writer id per page
+	QStringList mLabelNames;	// writer per page
+	QStringList mNames;			// page names (e.g. feature files) for the per query results
+	Distance mDistance = dist_cosine;
+
+	// results per query
+	QVector<double> mAvgPrecision;	// average precision (-1 if the writer has no other page)
+	QVector<int> mFirstHit;		// rank of the first page of the same writer
+	QVector<int> mFirstMiss;	// rank of the first page of another writer
+	QVector<QVector<QPair<int, float> > > mTopRanks;	// (page, distance) of the first maxRank results
+
+	static const int maxRank = 10;
+
+	void evaluateQuery(int qIdx, const float* dists);
+};
+
+};
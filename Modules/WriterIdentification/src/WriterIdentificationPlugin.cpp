@@ -23,6 +23,11 @@
  *******************************************************************************************************/
 
 #include "WriterIdentificationPlugin.h"
+#include "FeatureStore.h"
+#include "VocabularySampler.h"
+#include "VocabularyTrainer.h"
+#include "WriterEvaluation.h"
+#include "TiledFeatureExtractor.h"
 
  // nomacs includes
 #include "DkImageStorage.h"
@@ -44,6 +49,8 @@
 #include <QAction>
 #include <QSettings>
 #include <QImageWriter>
+#include <QElapsedTimer>
+#include <QtConcurrentMap>
 #include <opencv2/features2d.hpp>
 #pragma warning(pop)		// no warnings from includes - end
 
@@ -66,6 +73,7 @@ WriterIdentificationPlugin::WriterIdentificationPlugin(QObject* parent) : QObjec
 	runIds[id_extract_patches_per_page] = "926c8d0e57ff4cb0a1dab586e04847e7";
 	runIds[id_extract_random_patches] = "5553a82e4fbb4075bf36bdeec36b396b";
 	runIds[id_evaluate_database_transkribus] = "c89784c2460b47b49d4edf20e6b093cb";
+	runIds[id_add_to_index] = "100198c21bbc43b2ade8dbf675a3df1d";
 	mRunIDs = runIds.toList();
 
 	// create menu actions
@@ -80,6 +88,7 @@ WriterIdentificationPlugin::WriterIdentificationPlugin(QObject* parent) : QObjec
 	menuNames[id_extract_patches_per_page] = tr("Extract Patches Per Page");
 	menuNames[id_extract_random_patches] = tr("Extract Random Patches");
 	menuNames[id_evaluate_database_transkribus] = tr("Evaluate Database (Transkribus)");
+	menuNames[id_add_to_index] = tr("Add to Writer Index");
 	mMenuNames = menuNames.toList();
 
 	// create menu status tips
@@ -94,6 +103,7 @@ WriterIdentificationPlugin::WriterIdentificationPlugin(QObject* parent) : QObjec
 	statusTips[id_extract_patches] = tr("Extract Patches at SIFT keypoints and stores it in a directory of the filename");
 	statusTips[id_extract_random_patches] = ("Extract Patches on the page of random regions");
 	statusTips[id_evaluate_database_transkribus] = tr("Evaluate Database using the same code as in the Transkribus plugin");
+	statusTips[id_add_to_index] = tr("Adds the selected pages to the writer index used by Identify Writer");
 	mMenuStatusTips = statusTips.toList();
 
 	init();
@@ -170,6 +180,7 @@ QSharedPointer<nmc::DkImageContainer> WriterIdentificationPlugin::runPlugin(
 		rtc.setPen(pen);
 		rtc.setBrush(Qt::white);
 
+		cv::Mat cMaskC1;
 		QString loadXmlPath = rdf::PageXmlParser::imagePathToXmlPath(imgC->filePath());
 		if(QFileInfo(loadXmlPath).exists()) {
 			rdf::PageXmlParser parser;
@@ -186,12 +197,9 @@ QSharedPointer<nmc::DkImageContainer> WriterIdentificationPlugin::runPlugin(
 			}
 			
 			cv::Mat cMask = nmc::DkImage::qImage2Mat(qMask);
-			cv::Mat cMaskC1 = cv::Mat();
 			cv::cvtColor(cMask, cMaskC1, CV_RGB2GRAY);
-			wi.setMask(cMaskC1);
 		}
-		wi.setImage(imgCv);
-		wi.calculateFeatures();
+		calculateFeatures(wi, imgCv, cMaskC1);
 		cv::cvtColor(imgCv, imgCv, CV_RGB2GRAY);
 		qDebug() << "lenght:" << wi.keyPoints().size();
 		QVector<cv::KeyPoint> kp = wi.keyPoints();
@@ -221,7 +229,14 @@ QSharedPointer<nmc::DkImageContainer> WriterIdentificationPlugin::runPlugin(
 
 
 		QString fFilePath = featureFilePath(imgC->filePath(), true);
-		wi.saveFeatures(featureFilePath(imgC->filePath(), true));
+
+		if (mConfig.binaryFeatures()) {
+			FeatureStore store(fFilePath);
+			if (!store.write(wi.keyPoints(), wi.descriptors()))
+				qWarning() << store.errorString();
+		}
+		else
+			wi.saveFeatures(fFilePath);
 
 		QImage img = nmc::DkImage::mat2QImage(imgCv);
 		img = img.convertToFormat(QImage::Format_ARGB32);
@@ -233,7 +248,7 @@ QSharedPointer<nmc::DkImageContainer> WriterIdentificationPlugin::runPlugin(
 	else if(runID == mRunIDs[id_generate_vocabulary]) {
 		qInfo() << "collecting files for vocabulary generation";
 
-		QString ffPath = featureFilePath(imgC->filePath());
+		QString ffPath = findFeatureFile(imgC->filePath());
 
 		QString label = extractWriterIDFromFilename(QFileInfo(imgC->filePath()).baseName());
 
@@ -246,8 +261,45 @@ QSharedPointer<nmc::DkImageContainer> WriterIdentificationPlugin::runPlugin(
 	}
 	else if(runID == mRunIDs[id_identify_writer]) {
 		qInfo() << "identifying writer";
+
+		if(mVoc.isEmpty() || mWriterIndex.isEmpty()) {
+			qWarning() << "vocabulary or writer index is empty ... not identifying";
+			return imgC;
+		}
+
+		cv::Mat feature;
+		QString fFilePath = findFeatureFile(imgC->filePath());
+
+		if(QFileInfo(fFilePath).exists())
+			feature = featureVector(fFilePath, mVoc);
+		else {
+			rdf::WriterImage wi = rdf::WriterImage();
+			calculateFeatures(wi, nmc::DkImage::qImage2Mat(imgC->image()));
+			if(filterFeatures(wi, mVoc))
+				feature = mVoc.generateHist(wi.descriptors());
+		}
+
+		QElapsedTimer dt;
+		dt.start();
+		QString error;
+		QVector<WriterMatch> matches = mWriterIndex.query(feature, mConfig.numResults(), mConfig.numProbes(), &error);
+		qInfo() << "top" << matches.size() << "writers found in" << dt.elapsed() << "ms";
+
+		if(!error.isEmpty())
+			qWarning() << error;
+
+		for(const WriterMatch& m : matches)
+			qInfo() << m.writer << "\t" << m.imageName << "\t" << m.distance;
+
+		if(!matches.empty()) {
+			QSharedPointer<WIInfo> wInfo(new WIInfo(runID, imgC->filePath()));
+			wInfo->setWriter(matches.first().writer);
+			wInfo->setFeatureFilePath(fFilePath);
+			wInfo->setImageName(QFileInfo(imgC->filePath()).baseName());
+			info = wInfo;
+		}
 	}
-	else if(runID == mRunIDs[id_evaluate_database]) {
+	else if(runID == mRunIDs[id_evaluate_database] || runID == mRunIDs[id_add_to_index]) {
 		qInfo() << "collecting files evaluation";
 
 		if(mVoc.isEmpty()) {
@@ -255,46 +307,13 @@ QSharedPointer<nmc::DkImageContainer> WriterIdentificationPlugin::runPlugin(
 			return imgC;
 		}
 
-		QString fFilePath = featureFilePath(imgC->filePath());
+		QString fFilePath = findFeatureFile(imgC->filePath());
 
 		if(QFileInfo(fFilePath).exists()) {
 			
-			cv::FileStorage fs(fFilePath.toStdString(), cv::FileStorage::READ);
-			if(!fs.isOpened()) {
-				qWarning() << " unable to read file " << fFilePath;
+			cv::Mat feature = featureVector(fFilePath, mVoc);
+			if(feature.empty())
 				return imgC;
-			}
-			std::vector<cv::KeyPoint> kp;
-			fs["keypoints"] >> kp;
-			cv::Mat descriptors;
-			fs["descriptors"] >> descriptors;
-			fs.release();
-
-			if(mVoc.minimumSIFTSize() > 0 || mVoc.maximumSIFTSize() > 0) {
-				cv::Mat filteredDesc = cv::Mat(0, descriptors.cols, descriptors.type());
-				int r = 0;
-				for(auto kpItr = kp.begin(); kpItr != kp.end(); r++) {
-					if(kpItr->size*1.5 * 4 > mVoc.maximumSIFTSize() && mVoc.maximumSIFTSize() > 0) {
-						kpItr = kp.erase(kpItr);
-					}
-					else if(kpItr->size * 1.5 * 4 < mVoc.minimumSIFTSize()) {
-						kpItr = kp.erase(kpItr);
-					}
-					else {
-						kpItr++;
-						filteredDesc.push_back(descriptors.row(r).clone());
-					}
-				}
-				qDebug() << "filtered " << descriptors.rows - filteredDesc.rows << " SIFT features (maxSize:" << mVoc.maximumSIFTSize() << " minSize:" << mVoc.minimumSIFTSize() << ")";
-				descriptors = filteredDesc;
-			}
-			else
-				qDebug() << "not filtering SIFT features, min or max size not set";
-
-			cv::Mat feature = mVoc.generateHist(descriptors);
-
-			rdf::Image::imageInfo(descriptors, "descriptors");
-			rdf::Image::imageInfo(feature, "feature");
 
 			QString label = extractWriterIDFromFilename(QFileInfo(imgC->filePath()).baseName());
 
@@ -324,33 +343,28 @@ QSharedPointer<nmc::DkImageContainer> WriterIdentificationPlugin::runPlugin(
 
 		rdf::WriterImage wi = rdf::WriterImage();
 
-		QString fFilePath = featureFilePath(imgC->filePath());
+		QString fFilePath = findFeatureFile(imgC->filePath());
+		FeatureStore store(fFilePath);	// must outlive wi - the descriptors might be mapped
+
 		if(QFileInfo(fFilePath).exists()) { // check if feature file exists
-			cv::FileStorage fs(fFilePath.toStdString(), cv::FileStorage::READ);
-			if(!fs.isOpened()) {
-				qWarning() << " unable to read file " << fFilePath;
+			if(!store.read()) {
+				qWarning() << store.errorString();
 				return imgC;
 			}
-			std::vector<cv::KeyPoint> kp;
-			fs["keypoints"] >> kp;
-			cv::Mat descriptors;
-			fs["descriptors"] >> descriptors;
-			fs.release();
 
-			
 			wi.setImage(imgCv);
-			wi.setKeyPoints(QVector<cv::KeyPoint>::fromStdVector(kp));
-			wi.setDescriptors(descriptors);
-			wi.filterKeyPoints(mVoc.minimumSIFTSize(), mVoc.maximumSIFTSize());
+			wi.setKeyPoints(QVector<cv::KeyPoint>::fromStdVector(store.keyPoints()));
+			wi.setDescriptors(store.descriptors());
 			wInfo->setFeatureFilePath(fFilePath);
 		}
 		else { // calculate new features
-			wi.setImage(imgCv);
-			wi.calculateFeatures();
-			wi.filterKeyPoints(mVoc.minimumSIFTSize(), mVoc.maximumSIFTSize());
-
+			calculateFeatures(wi, imgCv);
 			wInfo->setFeatureFilePath("");
 		}
+
+		if(!filterFeatures(wi, mVoc))
+			return imgC;
+
 		cv::Mat feature = mVoc.generateHist(wi.descriptors());
 
 
@@ -410,17 +424,113 @@ void WriterIdentificationPlugin::postLoadPlugin(const QVector<QSharedPointer<nmc
 
 		wiDatabase.setVocabulary(voc);
 		qDebug() << "postLoad: vocabulary:" << voc.toString();
-		QStringList classLabels, featurePaths;
+
+		QStringList sourcePaths;
 		for(auto bi : batchInfo) {
 			WIInfo * wInfo = dynamic_cast<WIInfo*>(bi.data());
-			wiDatabase.addFile(wInfo->featureFilePath());
-			featurePaths.append(wInfo->featureFilePath());
+			sourcePaths.append(wInfo->featureFilePath());
+		}
+
+		// train on a bounded random sample of all descriptors (sampled in parallel)
+		rdf::Timer dt;
+		VocabularySampler sampler(mConfig.vocabularySamples(), voc.minimumSIFTSize(), voc.maximumSIFTSize());
+		DescriptorSample sample = sampler.sample(sourcePaths);
+		qInfo() << sample.descriptors.rows << "/" << sample.numSeen << "descriptors sampled from" << sourcePaths.size() << "files in" << dt;
+
+		if(sample.descriptors.empty()) {
+			qWarning() << "no descriptors found - vocabulary not generated";
+			return;
+		}
+
+		// fit the vocabulary in memory (the WriterDatabase would need the sample as yml file)
+		rdf::Timer tdt;
+		VocabularyTrainer trainer(voc);
+		if(!trainer.train(sample.descriptors)) {
+			qWarning() << trainer.errorString() << "- vocabulary not generated";
+			return;
+		}
+		qInfo() << "vocabulary fitted in" << tdt;
+		sample = DescriptorSample();
+
+		wiDatabase.setVocabulary(trainer.vocabulary());
+
+		QString vocPath = voc.type() == rdf::WriterVocabulary::WI_UNDEFINED ? "C://tmp//voc-woSettings.yml" : mWriterRetrievalConfig.vocabularyPath();
+		wiDatabase.saveVocabulary(vocPath);
+
+		// the page features are computed in memory (the WriterDatabase would need yml copies of binary feature files)
+		rdf::WriterVocabulary trainedVoc;
+		trainedVoc.loadVocabulary(vocPath);
+
+		rdf::Timer fdt;
+		QVector<int> fIdxs;
+		for(int idx = 0; idx < sourcePaths.size(); idx++)
+			fIdxs << idx;
+
+		QVector<cv::Mat> features(sourcePaths.size());
+		QtConcurrent::blockingMap(fIdxs, [&](int idx) {
+			features[idx] = featureVector(sourcePaths[idx], trainedVoc);
+		});
+
+		QStringList classLabels, featurePaths;
+		cv::Mat hists;
+		for(int idx = 0; idx < batchInfo.size(); idx++) {
+
+			if(features[idx].empty()) {
+				qWarning() << "no feature for" << sourcePaths[idx] << "... skipping";
+				continue;
+			}
+
+			WIInfo * wInfo = dynamic_cast<WIInfo*>(batchInfo[idx].data());
+			hists.push_back(features[idx]);
+			featurePaths.append(sourcePaths[idx]);
 			classLabels.append(wInfo->writer());
 		}
+		qInfo() << hists.rows << "page features computed in" << fdt;
+
+		if(mConfig.fastEvaluation()) {
+			rdf::Timer edt;
+			WriterEvaluation eval(hists, classLabels);
+			eval.setNames(featurePaths);
+			eval.compute();
+			qInfo().noquote() << eval.toString();
+			qInfo() << hists.rows << "pages evaluated in" << edt;
+		}
+		else
+			wiDatabase.evaluateDatabase(hists, classLabels, featurePaths, QString());
+	}
+	else if(runIdx == id_add_to_index) {
+
+		if(mConfig.indexPath().isEmpty()) {
+			qWarning() << "no writer index path specified ... not adding" << batchInfo.size() << "pages";
+			return;
+		}
+
+		WriterIndex index(mConfig.indexPath());
+		if(QFileInfo(index.filePath()).exists() && !index.load()) {
+			qWarning() << index.errorString();
+			return;
+		}
+
+		rdf::Timer dt;
+		for(auto bi : batchInfo) {
+			WIInfo * wInfo = dynamic_cast<WIInfo*>(bi.data());
+			if(!index.add(wInfo->featureVector(), wInfo->writer(), wInfo->imageName()))
+				qWarning() << index.errorString();
+		}
+
+		if(!index.isTrained() && index.numUntrained() >= mConfig.indexTrainSize())
+			index.train(mConfig.indexLists());
+		// the lists get too long if the index grew a lot since training
+		else if(index.isTrained() && mConfig.indexRetrainFactor() > 0 && index.size() >= index.trainedSize() * mConfig.indexRetrainFactor())
+			index.retrain(mConfig.indexLists());
 
-		wiDatabase.generateVocabulary();
-		wiDatabase.saveVocabulary(voc.type() == rdf::WriterVocabulary::WI_UNDEFINED ? "C://tmp//voc-woSettings.yml" : mWriterRetrievalConfig.vocabularyPath());
-		wiDatabase.evaluateDatabase(classLabels, featurePaths);
+		if(index.save())
+			qInfo() << batchInfo.size() << "pages added to" << index.filePath() << "(" << index.size() << "pages) in" << dt;
+		else
+			qWarning() << index.errorString();
+
+		// Identify Writer uses the updated index right away
+		mWriterIndex = index;
 	}
 	else if(runIdx == id_evaluate_database || runIdx == id_evaluate_database_transkribus) {
 		rdf::WriterDatabase wiDatabase = rdf::WriterDatabase(); 
@@ -481,7 +591,17 @@ void WriterIdentificationPlugin::postLoadPlugin(const QVector<QSharedPointer<nmc
 			evalFile += ".txt";
 		}
 
-		wiDatabase.evaluateDatabase(hists, classLabels, featurePaths, evalFile);
+		if(mConfig.fastEvaluation()) {
+			rdf::Timer dt;
+			WriterEvaluation eval(hists, classLabels);
+			eval.setNames(featurePaths);
+			eval.compute();
+			qInfo().noquote() << eval.toString();
+			qInfo() << batchInfo.size() << "pages evaluated in" << dt;
+			eval.write(evalFile);
+		}
+		else
+			wiDatabase.evaluateDatabase(hists, classLabels, featurePaths, evalFile);
 		//qDebug() << "writing competition file to:" << "c:/tmp/comp.csv";
 		//wiDatabase.writeCompetitionEvaluationFile(hists, imageNames, "c:/tmp/comp.csv");
 		qDebug() << "evaluation written to " << evalFile;
@@ -498,6 +618,7 @@ void WriterIdentificationPlugin::init() {
 	s.beginGroup(name());
 	mWriterRetrievalConfig.saveDefaultSettings(s);
 	mWriterVocConfig.saveDefaultSettings(s);
+	mConfig.saveDefaultSettings(s);
 	s.endGroup();
 }
 
@@ -505,23 +626,31 @@ void WriterIdentificationPlugin::loadSettings(QSettings & settings) {
 	settings.beginGroup(name());
 	mWriterRetrievalConfig.loadSettings(settings);
 	mWriterVocConfig.loadSettings(settings);
+	mConfig.loadSettings(settings);
 	settings.endGroup();
 
 	QFileInfo fi = QFileInfo(mWriterRetrievalConfig.vocabularyPath());
 	if(fi.exists()) {
 		mVoc.loadVocabulary(mWriterRetrievalConfig.vocabularyPath());
 	}
+
+	mWriterIndex = WriterIndex(mConfig.indexPath());
+	if(QFileInfo(mConfig.indexPath()).exists() && !mWriterIndex.load())
+		qWarning() << mWriterIndex.errorString();
 }
 
 void WriterIdentificationPlugin::saveSettings(QSettings & settings) const {
 	settings.beginGroup(name());
 	mWriterRetrievalConfig.saveSettings(settings);
 	mWriterVocConfig.saveSettings(settings);
+	mConfig.saveSettings(settings);
 	settings.endGroup();
 }
 
-QString WriterIdentificationPlugin::featureFilePath(QString imgPath, bool createDir) const {
-	QString extension = ".yml";
+QString WriterIdentificationPlugin::featureFilePath(QString imgPath, bool createDir, QString extension) const {
+	
+	if(extension.isEmpty())
+		extension = mConfig.binaryFeatures() ? FeatureStore::extension() : ".yml";
 
 	if(mWriterRetrievalConfig.featureDirectory().isEmpty()) {
 		QString featureFilePath = imgPath;
@@ -550,6 +679,120 @@ QString WriterIdentificationPlugin::featureFilePath(QString imgPath, bool create
 	}
 }
 
+/// <summary>
+/// Returns the feature file of imgPath.
+/// If no file exists in the configured format, the other one
+/// is used so that old yml features are still found.
+/// </summary>
+QString WriterIdentificationPlugin::findFeatureFile(const QString & imgPath) const {
+
+	QString fPath = featureFilePath(imgPath);
+	if(QFileInfo(fPath).exists())
+		return fPath;
+
+	QString altPath = featureFilePath(imgPath, false, mConfig.binaryFeatures() ? ".yml" : FeatureStore::extension());
+	if(QFileInfo(altPath).exists())
+		return altPath;
+
+	return fPath;
+}
+
+/// <summary>
+/// Loads the features, filters them by size and
+/// returns the page feature of voc.
+/// </summary>
+cv::Mat WriterIdentificationPlugin::featureVector(const QString & featureFilePath, const rdf::WriterVocabulary& voc) const {
+
+	FeatureStore store(featureFilePath);
+	if(!store.read()) {
+		qWarning() << store.errorString();
+		return cv::Mat();
+	}
+	std::vector<cv::KeyPoint> kp = store.keyPoints();
+	cv::Mat descriptors = store.descriptors();
+
+	if(voc.minimumSIFTSize() > 0 || voc.maximumSIFTSize() > 0) {
+		QElapsedTimer dt;
+		dt.start();
+		int numKp = (int)kp.size();
+		int numFiltered = FeatureStore::filterKeyPoints(kp, descriptors, voc.minimumSIFTSize(), voc.maximumSIFTSize());
+
+		if(numFiltered < 0) {
+			qWarning() << "keypoints and descriptors do not match in" << featureFilePath;
+			return cv::Mat();
+		}
+
+		qDebug() << "filtered " << numFiltered << "/" << numKp << " SIFT features (maxSize:" << voc.maximumSIFTSize() << " minSize:" << voc.minimumSIFTSize() << ") in" << dt.elapsed() << "ms";
+	}
+	else
+		qDebug() << "not filtering SIFT features, min or max size not set";
+
+	cv::Mat feature = voc.generateHist(descriptors);
+
+	rdf::Image::imageInfo(descriptors, "descriptors");
+	rdf::Image::imageInfo(feature, "feature");
+
+	return feature;
+}
+
+/// <summary>
+/// Removes the keypoints (and descriptors) of wi whose size is out of the vocabulary's range.
+/// FeatureStore::filterKeyPoints compacts both arrays in a single pass.
+/// </summary>
+/// <returns>false if the keypoints and descriptors of wi do not match.</returns>
+bool WriterIdentificationPlugin::filterFeatures(rdf::WriterImage & wi, const rdf::WriterVocabulary & voc) const {
+
+	std::vector<cv::KeyPoint> kp = wi.keyPoints().toStdVector();
+	cv::Mat descriptors = wi.descriptors();
+
+	if(FeatureStore::filterKeyPoints(kp, descriptors, voc.minimumSIFTSize(), voc.maximumSIFTSize()) < 0) {
+		qWarning() << "keypoints (" << kp.size() << ") and descriptors (" << descriptors.rows << ") do not match";
+		return false;
+	}
+
+	wi.setKeyPoints(QVector<cv::KeyPoint>::fromStdVector(kp));
+	wi.setDescriptors(descriptors);
+
+	return true;
+}
+
+/// <summary>
+/// Calculates the SIFT features of img.
+/// If a tile size is set, the features are computed on overlapping tiles concurrently.
+/// The overlap is derived from the maximum SIFT size so that all keypoints which
+/// pass the size filter match the ones of the whole page (see TiledFeatureExtractor::overlapFor).
+/// Set verifyTiling to check this on sample pages.
+/// </summary>
+void WriterIdentificationPlugin::calculateFeatures(rdf::WriterImage & wi, const cv::Mat & img, const cv::Mat & mask) const {
+
+	rdf::Timer dt;
+	if(!mask.empty())
+		wi.setMask(mask);
+	wi.setImage(img);
+
+	// the tiles are only equivalent to the whole page if the keypoint size is bounded
+	double maxSIFTSize = mWriterVocConfig.maxSIFTSize() > 0 ? mWriterVocConfig.maxSIFTSize() : mVoc.maximumSIFTSize();
+	bool tiled = mConfig.tileSize() > 0 && maxSIFTSize > 0;
+
+	if(mConfig.tileSize() > 0 && !tiled)
+		qDebug() << "SIFT tiling needs a maximum SIFT size - computing features on the whole page";
+
+	if(tiled) {
+		int overlap = qMax(mConfig.tileOverlap(), TiledFeatureExtractor::overlapFor(maxSIFTSize));
+		TiledFeatureExtractor tfe(mConfig.tileSize(), overlap, TiledFeatureExtractor::alignmentFor(maxSIFTSize));
+		tfe.compute(img, mask);
+		wi.setKeyPoints(tfe.keyPoints());
+		wi.setDescriptors(tfe.descriptors());
+
+		if(mConfig.verifyTiling() && tfe.agreement(img, mask, maxSIFTSize) < 0.99)
+			qWarning() << "tiled SIFT features differ from the whole page - consider setting tileSize to 0";
+	}
+	else
+		wi.calculateFeatures();
+
+	qDebug() << wi.keyPoints().size() << "SIFT features calculated in" << dt;
+}
+
 QString WriterIdentificationPlugin::extractWriterIDFromFilename(const QString fileName) const {
 	int idxOfMinus = fileName.indexOf("-");
 	int idxOfUScore = fileName.indexOf("_");
@@ -602,6 +845,103 @@ QString WIInfo::imageName() const {
 	return mImageName;
 }
 
+// WriterIdentificationConfig --------------------------------------------------------------------
+WriterIdentificationConfig::WriterIdentificationConfig() : ModuleConfig("Features") {
+}
+
+QString WriterIdentificationConfig::toString() const {
+
+	QString msg = rdf::ModuleConfig::toString();
+	msg += binaryFeatures() ? " binary feature files\n" : " yml feature files\n";
+	msg += " vocabulary samples: " + QString::number(vocabularySamples()) + "\n";
+	msg += " writer index: " + indexPath() + "\n";
+
+	if (tileSize() > 0)
+		msg += " SIFT tile size: " + QString::number(tileSize()) + " min overlap: " + QString::number(tileOverlap()) + (verifyTiling() ? " (verified)" : "") + "\n";
+
+	return msg;
+}
+
+bool WriterIdentificationConfig::binaryFeatures() const {
+	return mBinaryFeatures;
+}
+
+int WriterIdentificationConfig::vocabularySamples() const {
+	return mVocabularySamples;
+}
+
+QString WriterIdentificationConfig::indexPath() const {
+	return mIndexPath;
+}
+
+int WriterIdentificationConfig::numResults() const {
+	return mNumResults;
+}
+
+int WriterIdentificationConfig::numProbes() const {
+	return mNumProbes;
+}
+
+int WriterIdentificationConfig::indexTrainSize() const {
+	return mIndexTrainSize;
+}
+
+int WriterIdentificationConfig::indexLists() const {
+	return mIndexLists;
+}
+
+double WriterIdentificationConfig::indexRetrainFactor() const {
+	return mIndexRetrainFactor;
+}
+
+bool WriterIdentificationConfig::fastEvaluation() const {
+	return mFastEvaluation;
+}
+
+int WriterIdentificationConfig::tileSize() const {
+	return mTileSize;
+}
+
+int WriterIdentificationConfig::tileOverlap() const {
+	return mTileOverlap;
+}
+
+bool WriterIdentificationConfig::verifyTiling() const {
+	return mVerifyTiling;
+}
+
+void WriterIdentificationConfig::load(const QSettings & settings) {
+
+	mBinaryFeatures = settings.value("binaryFeatures", mBinaryFeatures).toBool();
+	mVocabularySamples = settings.value("vocabularySamples", mVocabularySamples).toInt();
+	mIndexPath = settings.value("indexPath", mIndexPath).toString();
+	mNumResults = settings.value("numResults", mNumResults).toInt();
+	mNumProbes = settings.value("numProbes", mNumProbes).toInt();
+	mIndexTrainSize = settings.value("indexTrainSize", mIndexTrainSize).toInt();
+	mIndexLists = settings.value("indexLists", mIndexLists).toInt();
+	mIndexRetrainFactor = settings.value("indexRetrainFactor", mIndexRetrainFactor).toDouble();
+	mFastEvaluation = settings.value("fastEvaluation", mFastEvaluation).toBool();
+	mTileSize = settings.value("tileSize", mTileSize).toInt();
+	mTileOverlap = settings.value("tileOverlap", mTileOverlap).toInt();
+	mVerifyTiling = settings.value("verifyTiling", mVerifyTiling).toBool();
+}
+
+void WriterIdentificationConfig::save(QSettings & settings) const {
+
+	settings.setValue("binaryFeatures", mBinaryFeatures);
+	settings.setValue("vocabularySamples", mVocabularySamples);
+	settings.setValue("indexPath", mIndexPath);
+	settings.setValue("numResults", mNumResults);
+	settings.setValue("numProbes", mNumProbes);
+	settings.setValue("indexTrainSize", mIndexTrainSize);
+	settings.setValue("indexLists", mIndexLists);
+	settings.setValue("indexRetrainFactor", mIndexRetrainFactor);
+	settings.setValue("fastEvaluation", mFastEvaluation);
+	settings.setValue("tileSize", mTileSize);
+	settings.setValue("tileOverlap", mTileOverlap);
+	settings.setValue("verifyTiling", mVerifyTiling);
+}
+
 };
 
 
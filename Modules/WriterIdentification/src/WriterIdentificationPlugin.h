@@ -27,10 +27,51 @@
 #include "DkPluginInterface.h"
 #include "WriterDatabase.h"
 #include "WriterRetrieval.h"
+#include "BaseModule.h"
+#include "WriterIndex.h"
 
 class QSettings;
 namespace rdm {
-	
+
+class WriterIdentificationConfig : public rdf::ModuleConfig {
+
+public:
+	WriterIdentificationConfig();
+
+	virtual QString toString() const override;
+
+	bool binaryFeatures() const;
+	int vocabularySamples() const;
+
+	QString indexPath() const;
+	int numResults() const;
+	int numProbes() const;
+	int indexTrainSize() const;
+	int indexLists() const;
+	double indexRetrainFactor() const;
+	bool fastEvaluation() const;
+	int tileSize() const;
+	int tileOverlap() const;
+	bool verifyTiling() const;
+
+protected:
+	bool mBinaryFeatures = false;		// save features in the binary FeatureStore instead of yml
+	int mVocabularySamples = 500000;	// max number of descriptors for vocabulary training (0 = all)
+	QString mIndexPath;					// the writer index file
+	int mNumResults = 10;				// number of writers returned by Identify Writer
+	int mNumProbes = 8;					// number of inverted lists scanned per query
+	int mIndexTrainSize = 1000;			// the index is trained once it contains this many pages
+	int mIndexLists = 0;				// number of inverted lists (0 = sqrt(#pages) when training)
+	double mIndexRetrainFactor = 4.0;	// the index is retrained once it grew by this factor since training (0 = never)
+	bool mFastEvaluation = true;		// evaluate with the blocked WriterEvaluation instead of rdf::WriterDatabase::evaluateDatabase
+	int mTileSize = 2048;				// SIFT extraction tile size (0 = no tiling, needs a maxSIFTSize - otherwise the whole page is used)
+	int mTileOverlap = 0;				// minimum overlap between SIFT tiles (it is at least derived from maxSIFTSize)
+	bool mVerifyTiling = false;			// compares the tiled features with the whole page (slow - use it on a few sample pages)
+
+	void load(const QSettings& settings) override;
+	void save(QSettings& settings) const override;
+};
+
 class WIInfo : public nmc::DkBatchInfo {
 
 public:
@@ -90,6 +131,7 @@ public:
 		id_extract_patches_per_page,
 		id_extract_random_patches,
 		id_evaluate_database_transkribus,
+		id_add_to_index,
 		// add actions here
 
 		id_end
@@ -106,13 +148,19 @@ private:
 	void init();
 	void loadSettings(QSettings& settings);
 	void saveSettings(QSettings& settings) const;
-	QString featureFilePath(QString imgPath, bool createDir=false) const;
+	QString featureFilePath(QString imgPath, bool createDir=false, QString extension = QString()) const;
+	QString findFeatureFile(const QString& imgPath) const;
+	cv::Mat featureVector(const QString& featureFilePath, const rdf::WriterVocabulary& voc) const;
+	void calculateFeatures(rdf::WriterImage& wi, const cv::Mat& img, const cv::Mat& mask = cv::Mat()) const;
+	bool filterFeatures(rdf::WriterImage& wi, const rdf::WriterVocabulary& voc) const;
 	QString extractWriterIDFromFilename(const QString fileName) const;
 
 	rdf::WriterRetrievalConfig mWriterRetrievalConfig;
 	rdf::WriterVocabularyConfig mWriterVocConfig;
+	WriterIdentificationConfig mConfig;
 
 	rdf::WriterVocabulary mVoc;
+	mutable WriterIndex mWriterIndex;	// updated by Add to Writer Index
 };
 
 };
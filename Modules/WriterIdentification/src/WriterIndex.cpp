@@ -0,0 +1,522 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#include "WriterIndex.h"
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+#include <QSet>
+#include <QDataStream>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+namespace {
+
+	const quint32 indexMagic = 0x49574452;	// RDWI
+	const quint32 indexVersion = 3;
+
+	void writeMat(QDataStream& ds, const cv::Mat& m) {
+
+		cv::Mat c = m.isContinuous() ? m : m.clone();
+		ds << (qint32)c.rows << (qint32)c.cols << (qint32)c.type();
+		if (!c.empty())
+			ds.writeRawData((const char*)c.data, (int)(c.total() * c.elemSize()));
+	}
+
+	cv::Mat readMat(QDataStream& ds) {
+
+		qint32 rows = 0, cols = 0, type = 0;
+		ds >> rows >> cols >> type;
+
+		cv::Mat m;
+		if (rows > 0 && cols > 0) {
+			m.create(rows, cols, type);
+			ds.readRawData((char*)m.data, (int)(m.total() * m.elemSize()));
+		}
+		else
+			m = cv::Mat(0, cols, type);
+
+		return m;
+	}
+}
+
+// WriterIndex --------------------------------------------------------------------
+WriterIndex::WriterIndex(const QString& filePath) {
+	mFilePath = filePath;
+}
+
+bool WriterIndex::load() {
+
+	QFile f(mFilePath);
+	if (!f.open(QIODevice::ReadOnly)) {
+		mError = "could not open " + mFilePath;
+		return false;
+	}
+
+	QDataStream ds(&f);
+	quint32 magic = 0, version = 0;
+	ds >> magic >> version;
+
+	if (magic != indexMagic) {
+		mError = mFilePath + " is not a writer index";
+		return false;
+	}
+
+	if (version != indexVersion) {
+		mError = mFilePath + " was written by another version - please create a new index";
+		return false;
+	}
+
+	qint32 dim = 0, numSub = 0, kSub = 0, trainedSize = 0;
+	ds >> dim >> numSub >> kSub >> trainedSize;
+	mDim = dim;
+	mNumSub = numSub;
+	mKSub = kSub;
+	mTrainedSize = trainedSize;
+
+	ds >> mWriters >> mImageNames;
+	mCentroids = readMat(ds);
+	mCodebooks = readMat(ds);
+
+	ds >> mLists;
+	mCodes.resize(mLists.size());
+	for (cv::Mat& c : mCodes)
+		c = readMat(ds);
+
+	mVectors = readMat(ds);
+	ds >> mRawIds;
+
+	if (ds.status() != QDataStream::Ok || mVectors.rows != mWriters.size()) {
+		mError = "corrupted writer index: " + mFilePath;
+		return false;
+	}
+
+	mIds.clear();
+	for (int idx = 0; idx < mImageNames.size(); idx++)
+		mIds.insert(mImageNames[idx], idx);
+
+	return true;
+}
+
+bool WriterIndex::save() {
+
+	QSaveFile f(mFilePath);
+	if (!f.open(QIODevice::WriteOnly)) {
+		mError = "could not open " + mFilePath + " for writing";
+		return false;
+	}
+
+	QDataStream ds(&f);
+	ds << indexMagic << indexVersion;
+	ds << (qint32)mDim << (qint32)mNumSub << (qint32)mKSub << (qint32)mTrainedSize;
+	ds << mWriters << mImageNames;
+	writeMat(ds, mCentroids);
+	writeMat(ds, mCodebooks);
+
+	ds << mLists;
+	for (const cv::Mat& c : mCodes)
+		writeMat(ds, c);
+
+	writeMat(ds, mVectors);
+	ds << mRawIds;
+
+	if (!f.commit()) {
+		mError = "could not write " + mFilePath;
+		return false;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Adds a page to the index.
+/// If the index is trained, the page is encoded immediately.
+/// A page that is already indexed (same image name) is replaced.
+/// </summary>
+/// <param name="feature">The page feature (generateHist).</param>
+/// <param name="writer">The writer label.</param>
+/// <param name="imageName">The image name.</param>
+/// <returns>false if the feature does not fit the index.</returns>
+bool WriterIndex::add(const cv::Mat & feature, const QString & writer, const QString & imageName) {
+
+	cv::Mat v = normalize(feature);
+
+	if (v.empty()) {
+		mError = "empty feature for " + imageName;
+		return false;
+	}
+
+	if (mDim == 0)
+		mDim = v.cols;
+	else if (v.cols != mDim) {
+		mError = QString("feature dimension %1 does not match the index (%2)").arg(v.cols).arg(mDim);
+		return false;
+	}
+
+	int id = imageName.isEmpty() ? -1 : mIds.value(imageName, -1);
+
+	if (id >= 0) {
+		remove(id);
+		mWriters[id] = writer;
+		v.copyTo(mVectors.row(id));
+	}
+	else {
+		id = mWriters.size();
+		mWriters << writer;
+		mImageNames << imageName;
+		mVectors.push_back(v);
+
+		if (!imageName.isEmpty())
+			mIds.insert(imageName, id);
+	}
+
+	if (isTrained()) {
+		int c = nearestCentroid(v);
+		mLists[c] << id;
+		mCodes[c].push_back(encode(v - mCentroids.row(c)));
+	}
+	else
+		mRawIds << id;
+
+	return true;
+}
+
+/// <summary>
+/// Trains the coarse & product quantizers on all pages
+/// that were added so far and encodes them.
+/// </summary>
+/// <param name="numLists">The number of inverted lists (0 = sqrt(#pages)).</param>
+/// <param name="numSubQuantizers">The number of PQ sub vectors (reduced to a divisor of the feature dimension).</param>
+/// <returns>true if the index was trained.</returns>
+bool WriterIndex::train(int numLists, int numSubQuantizers) {
+
+	if (isTrained()) {
+		mError = "the writer index is already trained";
+		return false;
+	}
+
+	int n = mRawIds.size();
+	if (n < 2) {
+		mError = "at least two pages are needed to train the writer index";
+		return false;
+	}
+
+	cv::Mat raw(n, mDim, CV_32FC1);
+	for (int rIdx = 0; rIdx < n; rIdx++)
+		mVectors.row(mRawIds[rIdx]).copyTo(raw.row(rIdx));
+
+	if (numLists <= 0)
+		numLists = qMax(1, (int)std::sqrt((double)n));
+	numLists = qMin(numLists, n);
+
+	cv::TermCriteria tc(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, 25, 1e-4);
+	cv::Mat labels;
+	cv::kmeans(raw, numLists, labels, tc, 1, cv::KMEANS_PP_CENTERS, mCentroids);
+
+	cv::Mat residuals(n, mDim, CV_32FC1);
+	for (int rIdx = 0; rIdx < n; rIdx++)
+		residuals.row(rIdx) = raw.row(rIdx) - mCentroids.row(labels.at<int>(rIdx));
+
+	// the sub quantizers must split the dimension evenly
+	mNumSub = qMax(1, qMin(numSubQuantizers, mDim));
+	while (mDim % mNumSub)
+		mNumSub--;
+
+	int dSub = mDim / mNumSub;
+	mKSub = qMin(256, n);
+	mCodebooks.create(mNumSub * mKSub, dSub, CV_32FC1);
+
+	for (int sIdx = 0; sIdx < mNumSub; sIdx++) {
+		cv::Mat sub = residuals.colRange(sIdx * dSub, (sIdx + 1) * dSub).clone();
+		cv::Mat subLabels, centers;
+		cv::kmeans(sub, mKSub, subLabels, tc, 1, cv::KMEANS_PP_CENTERS, centers);
+		centers.copyTo(mCodebooks.rowRange(sIdx * mKSub, (sIdx + 1) * mKSub));
+	}
+
+	mLists = QVector<QVector<int> >(numLists);
+	mCodes = QVector<cv::Mat>(numLists);
+	for (cv::Mat& c : mCodes)
+		c = cv::Mat(0, mNumSub, CV_8UC1);
+
+	for (int rIdx = 0; rIdx < n; rIdx++) {
+		int c = labels.at<int>(rIdx);
+		mLists[c] << mRawIds[rIdx];
+		mCodes[c].push_back(encode(residuals.row(rIdx)));
+	}
+
+	mRawIds.clear();
+	mTrainedSize = n;
+
+	qInfo() << "writer index trained:" << n << "pages," << numLists << "lists," << mNumSub << "x" << mKSub << "PQ";
+
+	return true;
+}
+
+/// <summary>
+/// Trains new quantizers on all pages and re-encodes them.
+/// The index keeps the original (normalized) features, so the new
+/// quantizers are trained on the pages and not on their PQ approximations.
+/// Use it if the index grew a lot since it was trained.
+/// </summary>
+/// <param name="numLists">The number of inverted lists (0 = sqrt(#pages)).</param>
+/// <param name="numSubQuantizers">The number of PQ sub vectors.</param>
+/// <returns>true if the index was trained.</returns>
+bool WriterIndex::retrain(int numLists, int numSubQuantizers) {
+
+	if (!isTrained())
+		return train(numLists, numSubQuantizers);
+
+	mRawIds.clear();
+	for (int idx = 0; idx < mVectors.rows; idx++)
+		mRawIds << idx;
+
+	mCentroids = cv::Mat();
+	mCodebooks = cv::Mat();
+	mLists.clear();
+	mCodes.clear();
+	mTrainedSize = 0;
+
+	return train(numLists, numSubQuantizers);
+}
+
+/// <summary>
+/// Returns the k closest writers.
+/// Pages are ranked by their distance to the query and each writer
+/// is reported once (with its closest page).
+/// This is thread-safe.
+/// </summary>
+/// <param name="feature">The query feature (generateHist).</param>
+/// <param name="k">The number of writers.</param>
+/// <param name="numProbes">The number of inverted lists that are scanned.</param>
+/// <param name="error">If set, it receives the error message (if any).</param>
+/// <returns>The matches sorted by distance.</returns>
+QVector<WriterMatch> WriterIndex::query(const cv::Mat & feature, int k, int numProbes, QString* error) const {
+
+	cv::Mat q = normalize(feature);
+
+	if (q.empty() || q.cols != mDim) {
+		if (error)
+			*error = "the query does not fit the writer index";
+		return QVector<WriterMatch>();
+	}
+
+	std::vector<std::pair<float, int> > candidates;
+
+	// exhaustive search on pages that are not encoded yet
+	for (int id : mRawIds)
+		candidates.push_back(std::make_pair((float)cv::norm(q, mVectors.row(id), cv::NORM_L2SQR), id));
+
+	if (isTrained()) {
+
+		std::vector<std::pair<float, int> > lists(mCentroids.rows);
+		for (int cIdx = 0; cIdx < mCentroids.rows; cIdx++)
+			lists[cIdx] = std::make_pair((float)cv::norm(q, mCentroids.row(cIdx), cv::NORM_L2SQR), cIdx);
+
+		int np = qMin(qMax(numProbes, 1), (int)lists.size());
+		std::partial_sort(lists.begin(), lists.begin() + np, lists.end());
+
+		int dSub = mDim / mNumSub;
+		std::vector<float> table(mNumSub * mKSub);
+
+		for (int pIdx = 0; pIdx < np; pIdx++) {
+
+			int c = lists[pIdx].second;
+			const cv::Mat& codes = mCodes[c];
+
+			if (codes.empty())
+				continue;
+
+			// distances of the query residual to all PQ centroids
+			cv::Mat r = q - mCentroids.row(c);
+			for (int sIdx = 0; sIdx < mNumSub; sIdx++) {
+				cv::Mat rs = r.colRange(sIdx * dSub, (sIdx + 1) * dSub);
+				for (int kIdx = 0; kIdx < mKSub; kIdx++)
+					table[sIdx * mKSub + kIdx] = (float)cv::norm(rs, mCodebooks.row(sIdx * mKSub + kIdx), cv::NORM_L2SQR);
+			}
+
+			for (int rIdx = 0; rIdx < codes.rows; rIdx++) {
+				const uchar* code = codes.ptr<uchar>(rIdx);
+				float d = 0;
+				for (int sIdx = 0; sIdx < mNumSub; sIdx++)
+					d += table[sIdx * mKSub + code[sIdx]];
+				candidates.push_back(std::make_pair(d, mLists[c][rIdx]));
+			}
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end());
+
+	// the closest page of each writer
+	QVector<WriterMatch> matches;
+	QSet<QString> writers;
+
+	for (const std::pair<float, int>& c : candidates) {
+
+		if (matches.size() >= k)
+			break;
+
+		const QString& w = mWriters[c.second];
+		if (writers.contains(w))
+			continue;
+
+		writers.insert(w);
+
+		WriterMatch m;
+		m.writer = w;
+		m.imageName = mImageNames[c.second];
+		m.distance = c.first;
+		matches << m;
+	}
+
+	return matches;
+}
+
+int WriterIndex::size() const {
+	return mWriters.size();
+}
+
+bool WriterIndex::isEmpty() const {
+	return mWriters.isEmpty();
+}
+
+bool WriterIndex::isTrained() const {
+	return !mCentroids.empty();
+}
+
+int WriterIndex::numUntrained() const {
+	return mRawIds.size();
+}
+
+/// <summary>
+/// Returns the number of pages the quantizers were trained on (0 if untrained).
+/// </summary>
+int WriterIndex::trainedSize() const {
+	return mTrainedSize;
+}
+
+QString WriterIndex::filePath() const {
+	return mFilePath;
+}
+
+QString WriterIndex::errorString() const {
+	return mError;
+}
+
+cv::Mat WriterIndex::normalize(const cv::Mat & feature) const {
+
+	if (feature.empty())
+		return cv::Mat();
+
+	cv::Mat v;
+	feature.reshape(1, 1).convertTo(v, CV_32FC1);
+	cv::normalize(v, v);	// L2 - the squared distance is then 2 - 2 cos
+
+	return v;
+}
+
+/// <summary>
+/// Removes page id from its inverted list (or from the pages that are not encoded yet).
+/// The page keeps its id (and its writer & image name).
+/// </summary>
+void WriterIndex::remove(int id) {
+
+	if (mRawIds.removeOne(id))
+		return;
+
+	for (int cIdx = 0; cIdx < mLists.size(); cIdx++) {
+
+		int rIdx = mLists[cIdx].indexOf(id);
+		if (rIdx < 0)
+			continue;
+
+		mLists[cIdx].remove(rIdx);
+
+		cv::Mat codes(0, mNumSub, CV_8UC1);
+		if (rIdx > 0)
+			codes.push_back(mCodes[cIdx].rowRange(0, rIdx));
+		if (rIdx + 1 < mCodes[cIdx].rows)
+			codes.push_back(mCodes[cIdx].rowRange(rIdx + 1, mCodes[cIdx].rows));
+		mCodes[cIdx] = codes;
+
+		return;
+	}
+}
+
+int WriterIndex::nearestCentroid(const cv::Mat & v) const {
+
+	int best = 0;
+	double bestDist = DBL_MAX;
+
+	for (int cIdx = 0; cIdx < mCentroids.rows; cIdx++) {
+		double d = cv::norm(v, mCentroids.row(cIdx), cv::NORM_L2SQR);
+		if (d < bestDist) {
+			bestDist = d;
+			best = cIdx;
+		}
+	}
+
+	return best;
+}
+
+cv::Mat WriterIndex::encode(const cv::Mat & residual) const {
+
+	int dSub = mDim / mNumSub;
+	cv::Mat code(1, mNumSub, CV_8UC1);
+
+	for (int sIdx = 0; sIdx < mNumSub; sIdx++) {
+
+		cv::Mat rs = residual.colRange(sIdx * dSub, (sIdx + 1) * dSub);
+		int best = 0;
+		double bestDist = DBL_MAX;
+
+		for (int kIdx = 0; kIdx < mKSub; kIdx++) {
+			double d = cv::norm(rs, mCodebooks.row(sIdx * mKSub + kIdx), cv::NORM_L2SQR);
+			if (d < bestDist) {
+				bestDist = d;
+				best = kIdx;
+			}
+		}
+
+		code.at<uchar>(sIdx) = (uchar)best;
+	}
+
+	return code;
+}
+
+};
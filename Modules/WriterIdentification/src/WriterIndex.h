@@ -0,0 +1,114 @@
+/*******************************************************************************************************
+ReadModules are plugins for nomacs developed at CVL/TU Wien for the EU project READ. 
+
+Copyright (C) 2016 Markus Diem <diem@cvl.tuwien.ac.at>
+Copyright (C) 2016 Stefan Fiel <fiel@cvl.tuwien.ac.at>
+Copyright (C) 2016 Florian Kleber <kleber@cvl.tuwien.ac.at>
+
+This file is part of ReadModules.
+
+ReadFramework is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+ReadFramework is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+The READ project  has  received  funding  from  the European  Unions  Horizon  2020  
+research  and innovation programme under grant agreement No 674943
+
+related links:
+[1] https://cvl.tuwien.ac.at/
+[2] https://transkribus.eu/Transkribus/
+[3] https://github.com/TUWien/
+[4] https://nomacs.org
+*******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes - begin
+#include <QString>
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+#include <opencv2/core.hpp>
+#pragma warning(pop)		// no warnings from includes - end
+
+namespace rdm {
+
+/// <summary>
+/// A single result of WriterIndex::query (a writer and its closest page).
+/// </summary>
+struct WriterMatch {
+	QString writer;
+	QString imageName;
+	float distance = 0;		// (approximate) squared L2 distance of the normalized features
+};
+
+/// <summary>
+/// Persistent approximate nearest neighbour index over page features
+/// (rdf::WriterVocabulary::generateHist).
+/// It is an inverted file (IVF): a k-means coarse quantizer assigns each
+/// page to a list and the residuals are product quantized (PQ) to one byte
+/// per sub vector. A query only scans the lists of the closest centroids.
+/// Pages added before the index is trained are searched exhaustively.
+/// The index keeps the original (normalized) features so that retrain()
+/// can fit new quantizers if the index grew a lot since training.
+/// Queries are aggregated by writer.
+/// </summary>
+class WriterIndex {
+
+public:
+	WriterIndex(const QString& filePath = QString());
+
+	bool load();
+	bool save();
+
+	bool add(const cv::Mat& feature, const QString& writer, const QString& imageName);
+	bool train(int numLists = 0, int numSubQuantizers = 64);
+	bool retrain(int numLists = 0, int numSubQuantizers = 64);
+	QVector<WriterMatch> query(const cv::Mat& feature, int k = 10, int numProbes = 8, QString* error = 0) const;
+
+	int size() const;
+	bool isEmpty() const;
+	bool isTrained() const;
+	int numUntrained() const;
+	int trainedSize() const;
+
+	QString filePath() const;
+	QString errorString() const;
+
+private:
+	QString mFilePath;
+	QString mError;
+
+	int mDim = 0;				// feature dimension
+	int mNumSub = 0;			// number of PQ sub quantizers
+	int mKSub = 0;				// centroids per sub quantizer (<= 256)
+	int mTrainedSize = 0;		// number of pages the quantizers were trained on
+
+	QStringList mWriters;		// per page
+	QStringList mImageNames;	// per page
+
+	cv::Mat mCentroids;			// coarse quantizer (numLists x dim)
+	cv::Mat mCodebooks;			// PQ codebooks (numSub * kSub x dim/numSub)
+	QVector<QVector<int> > mLists;	// page ids per list
+	QVector<cv::Mat> mCodes;	// PQ codes per list (CV_8UC1, one row per page)
+
+	cv::Mat mVectors;			// normalized features (one row per page)
+	QVector<int> mRawIds;		// pages that are not encoded yet
+	QHash<QString, int> mIds;	// page id per image name
+
+	cv::Mat normalize(const cv::Mat& feature) const;
+	int nearestCentroid(const cv::Mat& v) const;
+	cv::Mat encode(const cv::Mat& residual) const;
+	void remove(int id);
+};
+
+};
@@ -15,7 +15,7 @@ macro(RDM_FIND_QT)
 	GET_FILENAME_COMPONENT(QT_QMAKE_PATH ${QT_QMAKE_EXECUTABLE} PATH)
 	set(QT_ROOT ${QT_QMAKE_PATH}/)
 	SET(CMAKE_PREFIX_PATH ${CMAKE_PREFIX_PATH} ${QT_QMAKE_PATH}\\..\\lib\\cmake\\Qt5)
-	find_package(Qt5 REQUIRED Core Network Widgets LinguistTools)
+	find_package(Qt5 REQUIRED Core Network Widgets Concurrent LinguistTools)
 	if (NOT Qt5_FOUND)
 		message(FATAL_ERROR "Qt5 not found. Check your QT_QMAKE_EXECUTABLE path and set it to the correct location")
 	endif()